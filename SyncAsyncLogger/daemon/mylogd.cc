@@ -0,0 +1,130 @@
+/*
+    日志收集进程：扫描 /dev/shm 下由 ShmSink 创建的 mylog.* 共享内存环形队列，将其中的日志落地到文件
+    用法：mylogd [-d 输出目录] [-s 单个文件最大字节数] [-i 空闲时的轮询间隔(毫秒)]
+    1. 同名的多个进程写入同一组滚动文件：<输出目录>/<名称>-<时间>-<序号>.log
+    2. 写入端进程退出（包括崩溃）后，先将共享内存中剩余的日志落地，再删除共享内存对象
+    3. 每轮先读出所有队列并写入落地模块，刷新落地模块之后才发布各队列的读位置
+    4. 每隔 SCAN_INTERVAL_MS 毫秒（按时钟计算，与落地是否繁忙无关）扫描一次新的队列
+*/
+
+#include <map>
+#include <set>
+#include <memory>
+#include <chrono>
+#include <csignal>
+#include <cerrno>
+#include <dirent.h>
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+#define SCAN_INTERVAL_MS 100
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void onSignal(int) { g_stop = 1; }
+
+class Collector {
+public:
+    Collector(const std::string &dir, size_t max_size): _dir(dir), _max_size(max_size) {}
+    // 发现新创建的共享内存环形队列
+    void scan() {
+        DIR *dir = opendir("/dev/shm");
+        if (dir == nullptr) return;
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != nullptr) {
+            std::string name = ent->d_name;
+            if (name.compare(0, strlen(SHM_RING_PREFIX), SHM_RING_PREFIX) != 0) continue;
+            if (_rings.count(name)) continue;
+            std::unique_ptr<mylog::ShmRing> ring(new mylog::ShmRing());
+            if (ring->attach(name) == false) continue; // 可能尚未初始化完成，下次扫描再试
+            _rings[name] = std::move(ring);
+        }
+        closedir(dir);
+    }
+    // 落地所有队列中的日志，返回本轮落地的记录数量
+    size_t drain() {
+        size_t total = 0;
+        // 1. 读出所有队列中的日志，写入对应的落地模块
+        std::set<mylog::LogSink *> touched;
+        for (auto &it : _rings) {
+            mylog::ShmRing &ring = *it.second;
+            mylog::LogSink::ptr sink = sinkOf(ring.name());
+            size_t n = ring.drain(_scratch, [&](const char *data, size_t len) { sink->log(data, len); });
+            if (n > 0) touched.insert(sink.get());
+            total += n;
+        }
+        // 2. 落地模块刷新之后才发布读位置：此前退出时日志仍在共享内存中，重新启动后再次落地（可能重复，但不会丢失）
+        for (auto sink : touched) sink->flush();
+        for (auto &it : _rings) it.second->commit();
+        for (auto it = _rings.begin(); it != _rings.end(); ) {
+            mylog::ShmRing &ring = *it->second;
+            // 3. 队列损坏时无法再找到记录的边界，放弃该队列
+            if (ring.corrupt()) {
+                std::cerr << "mylogd: " << it->first << " is corrupt, discarded\n";
+                ring.unlink();
+                it = _rings.erase(it);
+                continue;
+            }
+            // 4. 写入端进程已经不存在且队列已空，回收共享内存
+            if (ring.empty() && kill(ring.pid(), 0) < 0 && errno == ESRCH) {
+                if (ring.dropped() > 0) {
+                    std::cerr << "mylogd: " << it->first << " dropped " << ring.dropped() << " records\n";
+                }
+                ring.unlink();
+                it = _rings.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        return total;
+    }
+private:
+    mylog::LogSink::ptr sinkOf(const std::string &name) {
+        auto it = _sinks.find(name);
+        if (it != _sinks.end()) return it->second;
+        std::string base = _dir + "/" + (name.empty() ? "unnamed" : name) + "-";
+        mylog::LogSink::ptr sink = mylog::SinkFactory::create<mylog::RollBySizeSink>(base, _max_size);
+        _sinks[name] = sink;
+        return sink;
+    }
+private:
+    std::string _dir;
+    size_t _max_size;
+    std::string _scratch;
+    std::map<std::string, std::unique_ptr<mylog::ShmRing>> _rings; // 共享内存文件名 -> 队列
+    std::map<std::string, mylog::LogSink::ptr> _sinks;              // 写入端名称 -> 落地模块
+};
+
+int main(int argc, char *argv[]) {
+    std::string dir = "./logfile";
+    size_t max_size = 100 * 1024 * 1024;
+    int interval_ms = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:i:")) != -1) {
+        switch (opt) {
+            case 'd': dir = optarg; break;
+            case 's': max_size = strtoull(optarg, nullptr, 10); break;
+            case 'i': interval_ms = atoi(optarg); break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [-d dir] [-s max_file_size] [-i interval_ms]\n";
+                return 1;
+        }
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    Collector collector(dir, max_size);
+    auto next_scan = std::chrono::steady_clock::now();
+    while (!g_stop) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_scan) {
+            collector.scan();
+            next_scan = now + std::chrono::milliseconds(SCAN_INTERVAL_MS);
+        }
+        if (collector.drain() > 0) continue;
+        usleep(interval_ms * 1000);
+    }
+    // 退出前最后落地一次
+    collector.scan();
+    collector.drain();
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <coroutine>
+#include <deque>
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    协程背压测试（C++20）：ASYNC_AWAIT 模式下，单线程事件循环中的多个协程持续写入日志
+    1. 落地模块故意放慢，生产缓冲区很快超过水位线，co_await logger->writable() 让出协程而不阻塞事件循环线程
+    2. 消费线程取走缓冲区后通过执行器把协程投递回事件循环恢复
+    3. 最后 co_await logger->flush() 等待全部落地，统计让出与恢复的次数以及落地的日志条数
+*/
+
+// 单线程事件循环：其他线程通过 post 投递回调，由 run 所在的线程依次执行
+class EventLoop {
+public:
+    void post(const std::function<void()> &fn) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _tasks.push_back(fn);
+        _cond.notify_one();
+    }
+    void run(int &alive) {
+        while (alive > 0) {
+            std::function<void()> fn;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond.wait(lock, [&]() { return !_tasks.empty(); });
+                fn = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+            fn();
+        }
+    }
+private:
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::function<void()>> _tasks;
+};
+
+// 立即开始执行、结束时自行销毁的协程
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// 落地缓慢的落地模块：每批日志额外耗时 200ms
+class SlowSink : public mylog::LogSink {
+public:
+    void log(const char *data, size_t len) {
+        for (size_t i = 0; i < len; ++i) _lines += data[i] == '\n';
+        usleep(200000);
+    }
+    size_t lines() const { return _lines; }
+private:
+    size_t _lines = 0;
+};
+
+static size_t g_suspends = 0; // 均只在事件循环线程中访问
+static size_t g_resumes = 0;
+
+// 包装 LogAwaitable，统计真正挂起以及挂起后被恢复的次数
+struct Counted {
+    explicit Counted(const mylog::LogAwaitable &inner): _inner(inner) {}
+    bool await_ready() { return _inner.await_ready(); }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        _suspended = _inner.await_suspend(handle);
+        if (_suspended) ++g_suspends;
+        return _suspended;
+    }
+    void await_resume() { if (_suspended) ++g_resumes; }
+    mylog::LogAwaitable _inner;
+    bool _suspended = false;
+};
+
+Task producer(mylog::Logger::ptr logger, mylog::Executor exec, int id, int count, int &alive) {
+    for (int i = 0; i < count; ++i) {
+        logger->info("协程 %d 的第 %d 条日志", id, i);
+        co_await Counted(logger->writable(exec));
+    }
+    co_await logger->flush(exec);
+    --alive;
+}
+
+int main() {
+    auto sink = std::make_shared<SlowSink>();
+    {
+        std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+        builder->buildLoggerName("await_logger");
+        builder->buildFormatter("[%d{%H:%M:%S}][%c][%p]%T%m%n");
+        builder->buildLoggerType(mylog::LoggerType::LOGGER_ASYNC);
+        builder->buildEnableAwaitAsync();
+        builder->buildSink(sink);
+        mylog::Logger::ptr logger = builder->build();
+
+        EventLoop loop;
+        mylog::Executor exec = [&loop](const std::function<void()> &fn) { loop.post(fn); };
+        const int producers = 4, count = 50000;
+        int alive = producers;
+        // 协程从事件循环中启动，之后的恢复也都在事件循环线程中进行
+        for (int id = 0; id < producers; ++id) {
+            loop.post([&, id]() { producer(logger, exec, id, count, alive); });
+        }
+        loop.run(alive);
+        std::cout << "suspends: " << g_suspends << ", resumes: " << g_resumes
+                  << ", lines: " << sink->lines() << " / " << producers * count << std::endl;
+    }
+    return 0;
+}
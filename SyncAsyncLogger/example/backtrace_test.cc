@@ -0,0 +1,34 @@
+#include "../logs/mylog.h"
+
+/*
+    回溯模式测试：日志器等级为 DEBUG，落地模块只输出 INFO 及以上，DEBUG 日志平时不落地
+    1. 同步与异步（消费者格式化）日志器各自开启回溯缓冲，保留每个线程最近 4 条 DEBUG 日志
+    2. 输出 6 条 DEBUG 与 1 条 INFO 日志后输出 ERROR 日志，标准输出中应在 ERROR 之前看到最近 4 条 DEBUG 日志
+    3. 之后的 ERROR 日志之前没有新的 DEBUG 日志，只输出其本身
+*/
+
+static void run(mylog::LoggerType type, const std::string &name) {
+    std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+    builder->buildLoggerName(name);
+    builder->buildLoggerType(type);
+    builder->buildLoggerLevel(mylog::LogLevel::value::DEBUG);
+    builder->buildBacktrace(4, mylog::LogLevel::value::DEBUG);
+    builder->buildFormatter("[%c][%p] %m%n");
+    if (type == mylog::LoggerType::LOGGER_ASYNC) builder->buildConsumerFormat(1);
+    auto sink = std::make_shared<mylog::StdoutSink>();
+    sink->setLevel(mylog::LogLevel::value::INFO);
+    builder->buildSink(sink);
+    mylog::Logger::ptr logger = builder->build();
+
+    for (int i = 0; i < 6; ++i) logger->debug("请求处理步骤 %d", i);
+    logger->info("请求处理中");
+    logger->error("请求处理失败");
+    logger->error("重试失败");
+    logger->flush().wait();
+}
+
+int main() {
+    run(mylog::LoggerType::LOGGER_SYNC, "sync_backtrace");
+    run(mylog::LoggerType::LOGGER_ASYNC, "async_backtrace");
+    return 0;
+}
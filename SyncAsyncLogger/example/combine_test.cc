@@ -0,0 +1,61 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "../logs/mylog.h"
+
+/*
+    平面合并测试：多个线程同时向同步日志器写入，统计落地模块实际被调用的次数
+    落地模块每次调用都是一次 writev 系统调用（写入 /dev/null），再休眠 20 微秒模拟较慢的存储设备；
+    落地期间其他线程发布的日志由下一个合并者一次落地，线程越多，每次调用合并的日志越多
+*/
+
+class DevNullSink : public mylog::LogSink {
+public:
+    DevNullSink(): _fd(::open("/dev/null", O_WRONLY | O_CLOEXEC)) {}
+    ~DevNullSink() { ::close(_fd); }
+    void log(const char *data, size_t len) {
+        struct iovec iov;
+        iov.iov_base = (void *)data;
+        iov.iov_len = len;
+        logBatchv(&iov, 1, mylog::LogBatch());
+    }
+    // 合并者将多个线程的日志以多段内存一次交给落地模块
+    void logBatchv(const struct iovec *iov, size_t cnt, const mylog::LogBatch &) override {
+        ssize_t ret = ::writev(_fd, iov, cnt);
+        (void)ret;
+        usleep(20);
+        ++_calls;
+        _lines += cnt;
+    }
+    size_t calls() const { return _calls; }
+    size_t lines() const { return _lines; }
+private:
+    int _fd;
+    size_t _calls = 0; // 均在落地模块的锁内更新
+    size_t _lines = 0;
+};
+
+int main() {
+    const int count = 20000;
+    for (int threads : {1, 2, 4, 8}) {
+        auto sink = std::make_shared<DevNullSink>();
+        std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+        builder->buildLoggerName("combine_logger");
+        builder->buildFormatter("[%d{%H:%M:%S}][%c][%p]%T%m%n");
+        builder->buildLoggerType(mylog::LoggerType::LOGGER_SYNC);
+        builder->buildSink(sink);
+        mylog::Logger::ptr logger = builder->build();
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> writers;
+        for (int t = 0; t < threads; ++t) {
+            writers.emplace_back([&, t]() {
+                for (int i = 0; i < count; ++i) logger->info("线程 %d 的第 %d 条日志", t, i);
+            });
+        }
+        for (auto &thr : writers) thr.join();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        printf("%d 个线程: %zu 条日志, %zu 次落地调用, 平均每次 %.1f 条, %.0f 条/秒\n", threads, sink->lines(),
+            sink->calls(), (double)sink->lines() / sink->calls(), threads * count / secs);
+    }
+    return 0;
+}
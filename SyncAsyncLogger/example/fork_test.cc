@@ -0,0 +1,96 @@
+#include <dirent.h>
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    fork 安全测试：后台线程持续写日志时反复 fork，子进程直接使用父进程的日志器
+    1. 两个全局异步日志器：fork_async 使用独立的消费线程并开启 2 个格式化线程，fork_pool 使用共享线程池
+       fork_async 同时写入每 64KB 滚动一次的 SharedRollBySizeSink，父子进程同时写入时协调滚动
+    2. 后台线程不断向两个日志器写入，主线程依次 fork 20 个子进程，每个子进程写 100 条日志、等待落地后退出
+    3. 子进程 10 秒内未退出（死锁）时被 SIGALRM 终止；最后核对各日志文件的行数既不丢失也不重复
+*/
+
+#define FORK_CHILDREN 20
+#define FORK_CHILD_COUNT 100
+#define FORK_BG_COUNT 200000
+
+static size_t countLines(const std::string &path) {
+    std::ifstream ifs(path);
+    std::string line;
+    size_t lines = 0;
+    while (std::getline(ifs, line)) ++lines;
+    return lines;
+}
+
+// 统计 ./logfile 下以 prefix 开头的滚动文件的总行数
+static size_t countRolled(const std::string &prefix) {
+    size_t lines = 0;
+    DIR *dir = opendir("./logfile");
+    if (dir == nullptr) return 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != nullptr) {
+        std::string name = ent->d_name;
+        if (name.compare(0, prefix.size(), prefix) != 0 || name.find(".lock") != std::string::npos) continue;
+        lines += countLines("./logfile/" + name);
+    }
+    closedir(dir);
+    return lines;
+}
+
+int main() {
+    const char *paths[2] = {"./logfile/fork_async.log", "./logfile/fork_pool.log"};
+    for (const char *path : paths) unlink(path);
+    system("rm -f ./logfile/fork_roll-*");
+    auto pool = std::make_shared<mylog::LooperPool>(2);
+    mylog::Logger::ptr loggers[2];
+    for (int k = 0; k < 2; ++k) {
+        std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::GlobalLoggerBuilder());
+        builder->buildLoggerName(k ? "fork_pool" : "fork_async");
+        builder->buildLoggerType(mylog::LoggerType::LOGGER_ASYNC);
+        if (k == 0) builder->buildConsumerFormat(2);
+        else builder->buildSharedLooper(pool);
+        builder->buildSink<mylog::FileSink>(paths[k]);
+        if (k == 0) builder->buildSink<mylog::SharedRollBySizeSink>("./logfile/fork_roll-", 64 * 1024);
+        loggers[k] = builder->build();
+    }
+
+    std::thread bg([&]() {
+        for (int i = 0; i < FORK_BG_COUNT; ++i) {
+            loggers[0]->info("后台线程 %d", i);
+            loggers[1]->info("后台线程 %d", i);
+        }
+    });
+    int failed = 0;
+    for (int c = 0; c < FORK_CHILDREN; ++c) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            alarm(10);
+            for (int i = 0; i < FORK_CHILD_COUNT; ++i) {
+                loggers[0]->info("子进程 %d 第 %d 条", c, i);
+                loggers[1]->info("子进程 %d 第 %d 条", c, i);
+            }
+            loggers[0]->flush().wait();
+            loggers[1]->flush().wait();
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cout << "child " << c << " failed, status " << status << std::endl;
+            ++failed;
+        }
+    }
+    bg.join();
+    loggers[0]->flush().wait();
+    loggers[1]->flush().wait();
+
+    size_t expect = FORK_BG_COUNT + FORK_CHILDREN * FORK_CHILD_COUNT;
+    std::cout << "children: " << FORK_CHILDREN - failed << " / " << FORK_CHILDREN << " exited cleanly" << std::endl;
+    for (int k = 0; k < 2; ++k) {
+        std::cout << paths[k] << ": " << countLines(paths[k]) << " / " << expect << " lines" << std::endl;
+    }
+    std::cout << "./logfile/fork_roll-*: " << countRolled("fork_roll-") << " / " << expect << " lines" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -1,4 +1,5 @@
 #include "../logs/mylog.h"
+#include "../logs/mysql_sink.hpp"
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -0,0 +1,26 @@
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    网络落地测试：先在本机启动一个接收端，再运行本程序
+        TCP:  nc -lk 9000
+        UDP:  nc -luk 9000
+    接收端中途退出再启动，可以观察到断线期间的日志在重连后补发
+*/
+
+int main(int argc, char *argv[]) {
+    int port = argc > 1 ? atoi(argv[1]) : 9000;
+    bool udp = argc > 2 && std::string(argv[2]) == "udp";
+    std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::GlobalLoggerBuilder());
+    builder->buildLoggerName("net_logger");
+    builder->buildFormatter("[%d{%H:%M:%S}][%c][%p]%T%m%n");
+    builder->buildLoggerType(mylog::LoggerType::LOGGER_ASYNC);
+    builder->buildSink<mylog::NetworkSink>("127.0.0.1", port,
+        udp ? mylog::NetworkSink::Protocol::SYSLOG_UDP : mylog::NetworkSink::Protocol::TCP);
+    mylog::Logger::ptr logger = builder->build();
+    for (int i = 0; i < 30; ++i) {
+        logger->info("第 %d 条网络日志", i);
+        sleep(1);
+    }
+    return 0;
+}
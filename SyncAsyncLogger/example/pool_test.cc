@@ -0,0 +1,61 @@
+#include <set>
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    共享线程池测试：9 个异步日志器共享 2 个消费线程
+    1. 其中一个日志器的落地模块很慢（每批休眠 50ms），长时间占用一个工作线程
+    2. 其余日志器由另一个工作线程从各队列中窃取处理，写入完成后很快全部落地，不被慢日志器拖住
+    3. 统计每个日志器的落地条数、等待落地的耗时以及处理过它的工作线程数
+*/
+
+class StatSink : public mylog::LogSink {
+public:
+    StatSink(int delay_us): _delay_us(delay_us) {}
+    void log(const char *data, size_t len) {
+        for (size_t i = 0; i < len; ++i) _lines += data[i] == '\n';
+        _workers.insert(std::this_thread::get_id());
+        if (_delay_us > 0) usleep(_delay_us);
+    }
+    size_t lines() const { return _lines; }
+    size_t workers() const { return _workers.size(); }
+private:
+    int _delay_us;
+    size_t _lines = 0; // 同一日志器同一时刻只由一个工作线程处理
+    std::set<std::thread::id> _workers;
+};
+
+int main() {
+    const int loggers = 8, count = 50000;
+    auto pool = std::make_shared<mylog::LooperPool>(2);
+    std::vector<mylog::Logger::ptr> list;
+    std::vector<std::shared_ptr<StatSink>> sinks;
+    for (int i = 0; i <= loggers; ++i) {
+        // 第 0 个为慢日志器
+        auto sink = std::make_shared<StatSink>(i == 0 ? 50000 : 0);
+        std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+        builder->buildLoggerName("pool_logger_" + std::to_string(i));
+        builder->buildFormatter("[%c][%p]%m%n");
+        builder->buildLoggerType(mylog::LoggerType::LOGGER_ASYNC);
+        builder->buildSharedLooper(pool);
+        builder->buildSink(sink);
+        list.push_back(builder->build());
+        sinks.push_back(sink);
+    }
+    std::vector<double> waited(list.size());
+    std::vector<std::thread> writers;
+    for (size_t i = 0; i < list.size(); ++i) {
+        writers.emplace_back([&, i]() {
+            for (int k = 0; k < count; ++k) list[i]->info("第 %d 条日志", k);
+            auto begin = std::chrono::steady_clock::now();
+            list[i]->flush().wait();
+            waited[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        });
+    }
+    for (auto &thr : writers) thr.join();
+    for (size_t i = 0; i < list.size(); ++i) {
+        printf("%s%-16s 落地 %zu / %d 条, 等待落地 %8.1f ms, 工作线程 %zu 个\n", i == 0 ? "(慢) " : "     ",
+            list[i]->name().c_str(), sinks[i]->lines(), count, waited[i], sinks[i]->workers());
+    }
+    return 0;
+}
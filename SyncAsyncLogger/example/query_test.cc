@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    旁路索引查询测试：生成带 .idx 索引的日志文件，并与 mylog-query 的查询结果对比
+    1. 两个日志器 query_a、query_b 共用一个开启索引的 FileSink，分三个阶段写入，每个阶段从新的一秒开始
+    2. 各等级轮流输出，INFO 日志为两行，其余为单行
+    3. 输出查询中间阶段 query_b 的 ERROR 及以上日志的命令与预期条数；先在 ../tools 下 make，
+       存在 ../tools/mylog-query 时直接执行该命令并统计输出行数，否则可手动执行后以 wc -l 对比
+*/
+
+#define QUERY_LOG "./logfile/query_test.log"
+#define QUERY_TOOL "../tools/mylog-query"
+
+// 当前时间所在的秒，与日志时间戳使用相同的时钟
+static time_t nowSec() { return (time_t)(mylog::Clock::now() / NS_PER_SEC); }
+
+// 等到下一秒开始，返回该秒
+static time_t nextSec() {
+    time_t cur = nowSec();
+    while (nowSec() == cur) usleep(1000);
+    return nowSec();
+}
+
+static std::string timeStr(time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+int main() {
+    unlink(QUERY_LOG);
+    unlink(QUERY_LOG INDEX_SUFFIX);
+    auto sink = std::make_shared<mylog::FileSink>(QUERY_LOG, true);
+    mylog::Logger::ptr loggers[2];
+    for (int k = 0; k < 2; ++k) {
+        std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+        builder->buildLoggerName(k ? "query_b" : "query_a");
+        builder->buildSink(sink);
+        loggers[k] = builder->build();
+    }
+
+    const int phases = 3, count = 30000;
+    time_t start[phases + 1];
+    size_t expect = 0;
+    for (int phase = 0; phase < phases; ++phase) {
+        start[phase] = nextSec();
+        for (int i = 0; i < count; ++i) {
+            int k = (i / 500) % 2;
+            mylog::Logger::ptr &logger = loggers[k];
+            switch (i % 5) {
+                case 0: logger->debug("阶段 %d 调试 %d", phase, i); break;
+                case 1: logger->info("阶段 %d 信息 %d\n第二行 %d", phase, i, i); break;
+                case 2: logger->warn("阶段 %d 警告 %d", phase, i); break;
+                case 3: logger->error("阶段 %d 错误 %d", phase, i); break;
+                default: logger->fatal("阶段 %d 致命 %d", phase, i); break;
+            }
+            if (phase == 1 && k == 1 && i % 5 >= 3) ++expect;
+        }
+    }
+    start[phases] = nextSec();
+
+    // 中间阶段从 start[1] 开始，在 start[2] 的前一秒之内结束（-e 包含该秒）
+    std::string cmd = std::string(QUERY_TOOL) + " -s '" + timeStr(start[1]) + "' -e '" + timeStr(start[2] - 1)
+        + "' -l ERROR -c query_b " + QUERY_LOG;
+    std::cout << "command: " << cmd << std::endl;
+    std::cout << "expect: " << expect << " lines" << std::endl;
+    if (access(QUERY_TOOL, X_OK) != 0) return 0;
+    FILE *fp = popen(cmd.c_str(), "r");
+    if (fp == nullptr) return 1;
+    size_t lines = 0;
+    int c;
+    while ((c = fgetc(fp)) != EOF) lines += c == '\n';
+    pclose(fp);
+    std::cout << "query: " << lines << " lines" << (lines == expect ? "" : " (mismatch)") << std::endl;
+    return lines == expect ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    运行时增删落地模块测试：多个线程持续写入日志，主线程同时反复增加、移除落地模块
+    1. 常驻的落地模块收到全部日志，临时落地模块只收到其挂载期间的日志
+    2. 第一次加入格式不同的落地模块时，异步日志器从生产者格式化切换为消费者格式化，切换期间不丢失、不重复日志
+*/
+
+// 统计收到的日志条数
+class CountSink : public mylog::LogSink {
+public:
+    void log(const char *data, size_t len) {
+        for (size_t i = 0; i < len; ++i) _lines += data[i] == '\n';
+    }
+    size_t lines() const { return _lines; }
+private:
+    size_t _lines = 0;
+};
+
+int main() {
+    const int threads = 4, count = 200000;
+    auto base = std::make_shared<CountSink>();
+    std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+    builder->buildLoggerName("rcu_logger");
+    builder->buildFormatter("[%c][%p]%m%n");
+    builder->buildLoggerType(mylog::LoggerType::LOGGER_ASYNC);
+    builder->buildSink(base);
+    mylog::Logger::ptr logger = builder->build();
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; i < count; ++i) logger->info("线程 %d 的第 %d 条日志", t, i);
+        });
+    }
+    // 写入期间反复挂载与移除临时落地模块，格式与常驻的落地模块不同
+    size_t swaps = 0, extra = 0;
+    for (int round = 0; round < 20; ++round) {
+        auto sink = std::make_shared<CountSink>();
+        sink->setPattern("%m%n");
+        logger->addSink(sink);
+        usleep(5000);
+        logger->removeSink(sink);
+        extra += sink->lines();
+        ++swaps;
+    }
+    for (auto &thr : writers) thr.join();
+    logger->flush().wait();
+    std::cout << "常驻落地模块: " << base->lines() << " / " << threads * count
+              << "，临时落地模块挂载 " << swaps << " 次，共收到 " << extra << " 条" << std::endl;
+    return 0;
+}
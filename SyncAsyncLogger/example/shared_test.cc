@@ -0,0 +1,57 @@
+#include <dirent.h>
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    多进程共享文件测试：父进程创建落地模块后 fork 出多个写入进程（预派生服务的常见用法）
+    1. 所有进程写入同一个 SharedFileSink，以及同一组 SharedRollBySizeSink 滚动文件（每 64KB 滚动一次）
+    2. 每个进程写 20000 条约 100 字节的日志，滚动由各进程在文件锁的保护下协调完成
+    3. 全部退出后统计 ./logfile/shared/ 下两组文件的总行数，应都等于写入的总条数
+*/
+
+#define SHARED_DIR "./logfile/shared/"
+#define SHARED_PROCS 8
+#define SHARED_COUNT 20000
+
+// 统计目录中以 prefix 开头的文件的总行数
+static size_t countLines(const std::string &prefix) {
+    size_t lines = 0;
+    DIR *dir = opendir(SHARED_DIR);
+    if (dir == nullptr) return 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != nullptr) {
+        std::string name = ent->d_name;
+        if (name.compare(0, prefix.size(), prefix) != 0 || name.find(".lock") != std::string::npos) continue;
+        std::ifstream ifs(SHARED_DIR + name);
+        std::string line;
+        while (std::getline(ifs, line)) ++lines;
+    }
+    closedir(dir);
+    return lines;
+}
+
+int main() {
+    system("rm -rf " SHARED_DIR);
+    std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+    builder->buildLoggerName("shared_logger");
+    builder->buildFormatter("[%d{%H:%M:%S}][%p]%T%m%n");
+    builder->buildSink<mylog::SharedFileSink>(SHARED_DIR "single.log");
+    builder->buildSink<mylog::SharedRollBySizeSink>(SHARED_DIR "roll-", 64 * 1024);
+    mylog::Logger::ptr logger = builder->build();
+
+    std::string pad(64, 'x');
+    for (int p = 0; p < SHARED_PROCS; ++p) {
+        if (fork() == 0) {
+            for (int i = 0; i < SHARED_COUNT; ++i) logger->info("进程 %d 第 %05d 条 %s", p, i, pad.c_str());
+            _exit(0);
+        }
+    }
+    for (int p = 0; p < SHARED_PROCS; ++p) wait(nullptr);
+
+    size_t expect = SHARED_PROCS * SHARED_COUNT;
+    std::cout << "SharedFileSink: " << countLines("single") << " / " << expect << " lines" << std::endl;
+    std::cout << "SharedRollBySizeSink: " << countLines("roll-") << " / " << expect << " lines" << std::endl;
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    共享内存落地测试：先启动日志收集进程，再运行本程序
+        ../daemon/mylogd -d ./logfile &
+        ./shm_test 4
+    1. 启动若干子进程，各自通过 ShmSink 写入名为 shm_test 的共享内存队列（每个进程一个队列）
+    2. 第一个子进程写完后直接 abort()，模拟崩溃：已写入共享内存的日志仍由 mylogd 落地
+    3. 全部落地后 ./logfile/shm_test-*.log 中的行数应等于输出的总条数
+*/
+
+int main(int argc, char *argv[]) {
+    int procs = argc > 1 ? atoi(argv[1]) : 4;
+    const int count = 100000;
+    for (int p = 0; p < procs; ++p) {
+        pid_t pid = fork();
+        if (pid < 0) return 1;
+        if (pid > 0) continue;
+        std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+        builder->buildLoggerName("shm_logger");
+        builder->buildFormatter("[%d{%H:%M:%S}][%c][%p]%T%m%n");
+        builder->buildSink<mylog::ShmSink>("shm_test");
+        mylog::Logger::ptr logger = builder->build();
+        for (int i = 0; i < count; ++i) logger->info("进程 %d 的第 %d 条日志", (int)getpid(), i);
+        if (p == 0) abort();
+        return 0;
+    }
+    int crashed = 0;
+    for (int p = 0; p < procs; ++p) {
+        int status;
+        wait(&status);
+        if (WIFSIGNALED(status)) ++crashed;
+    }
+    std::cout << procs << " 个进程共写入 " << procs * count << " 条日志（其中 " << crashed
+              << " 个进程崩溃退出），由 mylogd 落地到 shm_test-*.log" << std::endl;
+    return 0;
+}
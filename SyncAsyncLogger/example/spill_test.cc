@@ -0,0 +1,78 @@
+#include <unistd.h>
+#include "../logs/mylog.h"
+
+/*
+    溢出重放测试：ASYNC_SPILL 模式下落地模块暂时变慢，写入线程不被阻塞
+    1. 落地模块起初每批休眠 50ms，4 个线程持续写入，生产缓冲区超过 256KB 后整批溢出到 ./logfile/spill 下的临时文件
+    2. 写入结束后落地模块恢复正常，消费线程按原顺序重放溢出的数据
+    3. 统计溢出的字节数、单次写入的最长耗时、落地的条数以及各线程日志的乱序条数
+*/
+
+#define SPILL_THREADS 4
+#define SPILL_COUNT 100000
+
+// 解析每行的 "线程号 序号"，检查同一线程的日志是否按写入顺序落地
+class OrderSink : public mylog::LogSink {
+public:
+    OrderSink(): _slow(true), _lines(0), _disorder(0) {
+        for (int t = 0; t < SPILL_THREADS; ++t) _next[t] = 0;
+    }
+    void log(const char *data, size_t len) {
+        const char *end = data + len;
+        while (data < end) {
+            const char *nl = (const char *)memchr(data, '\n', end - data);
+            if (nl == nullptr) nl = end;
+            int t = 0, i = 0;
+            if (sscanf(data, "%d %d", &t, &i) == 2 && t >= 0 && t < SPILL_THREADS) {
+                if (i != _next[t]) ++_disorder;
+                _next[t] = i + 1;
+            }
+            ++_lines;
+            data = nl + 1;
+        }
+        if (_slow.load()) usleep(50000);
+    }
+    void recover() { _slow.store(false); }
+    size_t lines() const { return _lines; }
+    size_t disorder() const { return _disorder; }
+private:
+    std::atomic<bool> _slow;
+    size_t _lines;      // 只在消费线程中访问
+    size_t _disorder;
+    int _next[SPILL_THREADS];
+};
+
+int main() {
+    auto sink = std::make_shared<OrderSink>();
+    int64_t max_ns[SPILL_THREADS] = {0};
+    {
+        std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+        builder->buildLoggerName("spill_logger");
+        builder->buildFormatter("%m%n");
+        builder->buildLoggerType(mylog::LoggerType::LOGGER_ASYNC);
+        builder->buildEnableSpillAsync("./logfile/spill", 256 * 1024);
+        builder->buildSink(sink);
+        mylog::Logger::ptr logger = builder->build();
+
+        std::vector<std::thread> writers;
+        for (int t = 0; t < SPILL_THREADS; ++t) {
+            writers.emplace_back([&, t]() {
+                for (int i = 0; i < SPILL_COUNT; ++i) {
+                    int64_t begin = mylog::Clock::now();
+                    logger->info("%d %d 溢出重放测试", t, i);
+                    max_ns[t] = std::max(max_ns[t], mylog::Clock::now() - begin);
+                }
+            });
+        }
+        for (auto &th : writers) th.join();
+        auto async = std::dynamic_pointer_cast<mylog::AsyncLogger>(logger);
+        std::cout << "spilled: " << async->spilled() << " bytes" << std::endl;
+        sink->recover();
+        // 日志器析构时等待全部日志（包括溢出文件中的）落地
+    }
+    int64_t max_all = *std::max_element(max_ns, max_ns + SPILL_THREADS);
+    std::cout << "max log() call: " << max_all / 1000 << " us" << std::endl;
+    std::cout << "lines: " << sink->lines() << " / " << SPILL_THREADS * SPILL_COUNT
+              << ", disorder: " << sink->disorder() << std::endl;
+    return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef __M_BACKTRACE_H__
+#define __M_BACKTRACE_H__
+/*
+    回溯模式：低于日志器输出等级的日志不落地，而是保存在线程本地的环形缓冲中
+    1. 捕获时只生成有效载荷，不经过 Formatter，也不进入落地流程，且槽位空间复用，热身后没有内存分配
+    2. 当同一线程在该日志器上输出 ERROR 及以上等级的日志时，先将环形缓冲中最近的 N 条日志按顺序落地
+*/
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdarg>
+#include <unordered_map>
+#include "level.hpp"
+#include "message.hpp"
+
+namespace mylog {
+    class Backtrace {
+    public:
+        using ptr = std::shared_ptr<Backtrace>;
+        // 单个线程的环形缓冲区
+        class Ring {
+        public:
+            Ring(size_t capacity): _slots(capacity, LogMsg(LogLevel::value::UNKNOW, 0, "", "", "")),
+                _payloads(capacity), _contexts(capacity), _start(0), _size(0) {}
+            // 获取下一个可写槽位，缓冲区满时覆盖最旧的日志
+            // LogMsg 不持有有效载荷与线程上下文，payload、context 为该槽位保存其副本的空间
+            LogMsg &next(std::string *&payload, std::string *&context) {
+                size_t idx = (_start + _size) % _slots.size();
+                if (_size == _slots.size()) _start = (_start + 1) % _slots.size();
+                else ++_size;
+                payload = &_payloads[idx];
+                context = &_contexts[idx];
+                return _slots[idx];
+            }
+            // 按从旧到新的顺序取出所有日志，处理完毕后清空缓冲区
+            template<typename Callback>
+            void drain(Callback cb) {
+                for (size_t i = 0; i < _size; ++i) {
+                    cb(_slots[(_start + i) % _slots.size()]);
+                }
+                _start = 0;
+                _size = 0;
+            }
+            bool empty() const { return _size == 0; }
+        private:
+            std::vector<LogMsg> _slots;
+            std::vector<std::string> _payloads;
+            std::vector<std::string> _contexts;
+            size_t _start;
+            size_t _size;
+        };
+
+        Backtrace(size_t capacity, LogLevel::value level):
+            _id(nextId()), _capacity(capacity == 0 ? 1 : capacity), _level(level) {}
+        // 捕获等级下限，低于此等级的日志直接丢弃
+        LogLevel::value level() const { return _level; }
+        // 将一条日志写入当前线程的环形缓冲
+        void capture(LogLevel::value level, const char *file, size_t line,
+            const std::string &logger, const std::string &fmt, va_list ap) {
+            std::string *payload, *context;
+            LogMsg &msg = local().next(payload, context);
+            msg._ns = Clock::now();
+            msg._ctime = msg._ns / NS_PER_SEC;
+            msg._level = level;
+            msg._line = line;
+            msg._tid = std::this_thread::get_id();
+            msg._file = file; // 静态字符串
+            msg._file_len = strlen(file);
+            msg._logger = logger.data(); // 回溯缓冲只由所属的日志器输出，名称随日志器存在
+            msg._logger_len = logger.size();
+            // 上下文在输出之前可能已经改变，保存一份副本
+            ThreadContext &ctx = ThreadContext::local();
+            context->assign(ctx.data(), ctx.size());
+            msg._context = context->data();
+            msg._context_len = context->size();
+            // 直接格式化到槽位已有的空间中
+            util::Str::vformat(*payload, fmt.c_str(), ap);
+            msg._payload = payload->data();
+            msg._payload_len = payload->size();
+        }
+        // 取出当前线程缓冲的日志（从旧到新），交由回调完成落地
+        template<typename Callback>
+        void dump(Callback cb) {
+            Ring *ring = find();
+            if (ring != nullptr && !ring->empty()) ring->drain(cb);
+        }
+    private:
+        static uint64_t nextId() {
+            static std::atomic<uint64_t> id(0);
+            return ++id;
+        }
+        // 每个线程保存自己在各个日志器上的环形缓冲，以日志器的唯一编号区分
+        static std::unordered_map<uint64_t, std::unique_ptr<Ring>> &rings() {
+            static thread_local std::unordered_map<uint64_t, std::unique_ptr<Ring>> rings;
+            return rings;
+        }
+        Ring *find() {
+            auto &all = rings();
+            auto it = all.find(_id);
+            return it == all.end() ? nullptr : it->second.get();
+        }
+        Ring &local() {
+            // 绝大多数线程只在一个日志器上写日志，缓存最近一次的查找结果
+            static thread_local uint64_t last_id = 0;
+            static thread_local Ring *last_ring = nullptr;
+            if (last_id == _id) return *last_ring;
+            std::unique_ptr<Ring> &ring = rings()[_id];
+            if (ring.get() == nullptr) ring.reset(new Ring(_capacity));
+            last_id = _id;
+            last_ring = ring.get();
+            return *last_ring;
+        }
+    private:
+        uint64_t _id;
+        size_t _capacity;
+        LogLevel::value _level;
+    };
+}
+
+#endif /* __M_BACKTRACE_H__ */
@@ -4,25 +4,44 @@
 
 #include <vector>
 #include <cassert>
+#include <sys/uio.h>
 #include "util.hpp"
+#include "index.hpp"
 
 namespace mylog {
     
     #define DEFAULT_BUFFER_SIZE (1 * 1024 * 1024)
     #define THRESHOLD_BUFFER_SIZE (8 * 1024 *1024)
     #define INCREMENT_BUFFER_SIZE (1 * 1024 * 1024)
+    #define BUFFER_SLICE_SIZE (64 * 1024)
     class Buffer {
     public:
-        Buffer() : _buffer(DEFAULT_BUFFER_SIZE), _writer_idx(0), _reader_idx(0) {}
+        Buffer(size_t size = DEFAULT_BUFFER_SIZE) : _buffer(size), _reader_idx(0), _writer_idx(0) {}
         // 向缓冲区写入数据
         void push(const char* data, size_t len) {
             // 1. 考虑空间不够则扩容
             ensureEnoughSize(len);
+            mark();
             // 1. 将数据拷贝进缓冲区
             std::copy(data, data + len, &_buffer[_writer_idx]);
             // 2. 将当前写入位置向后偏移
             moveWriter(len);
         }
+        // 将多个片段连续写入缓冲区
+        void push(const struct iovec *iov, size_t cnt) {
+            ensureEnoughSize(length(iov, cnt));
+            mark();
+            for (size_t i = 0; i < cnt; ++i) {
+                const char *data = (const char *)iov[i].iov_base;
+                std::copy(data, data + iov[i].iov_len, &_buffer[_writer_idx]);
+                moveWriter(iov[i].iov_len);
+            }
+        }
+        static size_t length(const struct iovec *iov, size_t cnt) {
+            size_t len = 0;
+            for (size_t i = 0; i < cnt; ++i) len += iov[i].iov_len;
+            return len;
+        }
         size_t writeAbleSize() {
             // 对于扩容思路来说，不存在可写空间大小，因为总是可写
             // 因此这个接口仅仅针对固定大小缓冲区提供
@@ -46,17 +65,46 @@ namespace mylog {
         void reset() {
             _writer_idx = 0; // 缓冲区所有空间都是空闲的
             _reader_idx = 0; // 与 _writer_idx 相等表示没有数据可读
+            _batch.clear();
+            _slices.clear();
+        }
+        // 空缓冲区不足 size 时预先分配到 size
+        void reserve(size_t size) {
+            if (_buffer.size() >= size || !empty()) return;
+            _buffer.resize(size);
+        }
+        // 空缓冲区超过 size 时释放多余的空间
+        void shrink(size_t size) {
+            if (_buffer.size() <= size || !empty()) return;
+            std::vector<char>(size).swap(_buffer);
         }
         // 对 Buffer 实现交换操作
         void swap(Buffer &buffer) {
             _buffer.swap(buffer._buffer);
             std::swap(_reader_idx, buffer._reader_idx);
             std::swap(_writer_idx, buffer._writer_idx);
+            std::swap(_batch, buffer._batch);
+            _slices.swap(buffer._slices);
         }
         // 判断缓冲区是否为空
         bool empty() {
             return (_reader_idx == _writer_idx);
         }
+        // 记录写入的日志的时间与等级，消费者据此得到整批日志的概要信息
+        void note(time_t ctime, LogLevel::value level) {
+            _batch.add(ctime, level);
+            _slices.back()._batch.add(ctime, level);
+        }
+        const LogBatch &batch() const { return _batch; }
+        // 缓冲区按写入的边界切分为约 BUFFER_SLICE_SIZE 大小的分片，消费者可以逐片处理，在分片之间插入其他工作
+        size_t slices() const { return _slices.size(); }
+        // 第 i 个分片的起始地址与长度，batch 为分片中日志的概要信息
+        const char *slice(size_t i, size_t &len, const LogBatch *&batch) {
+            size_t end = i + 1 < _slices.size() ? _slices[i + 1]._begin : _writer_idx;
+            len = end - _slices[i]._begin;
+            batch = &_slices[i]._batch;
+            return &_buffer[_slices[i]._begin];
+        }
     private:
         // 对空间进行扩容
         void ensureEnoughSize(size_t len) {
@@ -70,6 +118,12 @@ namespace mylog {
             _buffer.resize(new_size);
         }
         // 对读写指针进行向后偏移操作
+        // 写入一个整体之前判断是否开始新的分片
+        void mark() {
+            if (_slices.empty() || _writer_idx - _slices.back()._begin >= BUFFER_SLICE_SIZE) {
+                _slices.push_back(Slice{_writer_idx, LogBatch()});
+            }
+        }
         void moveWriter(size_t len) {
             assert((len + _writer_idx) <= _buffer.size());
             _writer_idx += len;
@@ -78,6 +132,12 @@ namespace mylog {
         std::vector<char> _buffer;
         size_t _reader_idx; // 当前可读数据的指针 -- 本质是下标
         size_t _writer_idx; // 当前可写数据的指针
+        LogBatch _batch;    // 缓冲区中日志的概要信息
+        struct Slice {
+            size_t _begin;
+            LogBatch _batch;
+        };
+        std::vector<Slice> _slices;
     };
 } 
 
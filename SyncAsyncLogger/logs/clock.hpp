@@ -0,0 +1,205 @@
+#ifndef __M_CLOCK_H__
+#define __M_CLOCK_H__
+/*
+    日志时间戳的时钟源：返回自 1970-01-01 起的纳秒数
+    1. 首次使用时检测并校准：CPU 支持恒定频率的 TSC 时，以 rdtsc 换算为墙上时间，每次读取只需几个时钟周期
+    2. TSC 换算参数每隔 CLOCK_RESYNC_NS 由读取线程顺带以 CLOCK_REALTIME 重新校准，参数以顺序锁发布；
+       校准时墙上时间落后于按原参数推算的时间时不回退，而是降低速率在下一个间隔内追平
+    3. 不支持 TSC 时：CLOCK_REALTIME 读取开销较低则直接使用，否则退回 CLOCK_REALTIME_COARSE（毫秒级精度）
+    4. 也可在输出日志之前以 Clock::init() 指定时钟源，如 CLOCK_MONOTONIC（启动时换算一次与墙上时间的偏移）
+*/
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <ctime>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define MYLOG_HAVE_TSC 1
+#endif
+
+namespace mylog {
+
+    #define NS_PER_SEC 1000000000LL
+    #define CLOCK_RESYNC_NS NS_PER_SEC         // TSC 重新校准的间隔
+    #define CLOCK_CALIBRATE_NS (10 * 1000000LL) // 启动时校准 TSC 的采样时长
+    #define CLOCK_FAST_CALL_NS 100             // CLOCK_REALTIME 平均读取开销低于此值时视为足够快
+
+    class Clock {
+    public:
+        enum class source { AUTO, TSC, REALTIME, REALTIME_COARSE, MONOTONIC };
+        // 当前时间（纳秒）
+        static int64_t now() { return instance().read(); }
+        // 指定时钟源，应在输出日志之前调用（与读取并发时，切换前后的时间戳可能来自不同的时钟源）；TSC 不可用时自动检测
+        static void init(source src) { instance().select(src); }
+        static source current() { return instance()._source.load(std::memory_order_acquire); }
+        // 当前时钟源的名称
+        static const char *name() {
+            switch (current()) {
+                case source::TSC: return "tsc";
+                case source::REALTIME: return "realtime";
+                case source::REALTIME_COARSE: return "realtime_coarse";
+                case source::MONOTONIC: return "monotonic";
+                default: return "auto";
+            }
+        }
+    private:
+        Clock(): _source(source::AUTO), _seq(0), _resyncing(false), _base_tsc(0), _base_ns(0), _ns_per_tick(0), _resync_ticks(0), _max_resync_ticks(0), _offset(0),
+            _sample_tsc(0), _sample_ns(0), _rate(0) {
+            select(source::AUTO);
+        }
+        static Clock &instance() {
+            static Clock clock;
+            return clock;
+        }
+        static int64_t clockNs(clockid_t id) {
+            struct timespec ts;
+            clock_gettime(id, &ts);
+            return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+        }
+        int64_t read() {
+            switch (_source.load(std::memory_order_acquire)) {
+#ifdef MYLOG_HAVE_TSC
+                case source::TSC: return readTsc();
+#endif
+                case source::REALTIME_COARSE: return clockNs(CLOCK_REALTIME_COARSE);
+                case source::MONOTONIC: return clockNs(CLOCK_MONOTONIC) + _offset.load(std::memory_order_relaxed);
+                default: return clockNs(CLOCK_REALTIME);
+            }
+        }
+        // 先准备好新时钟源的参数再发布 _source，读取线程看到新时钟源时参数已就绪
+        void select(source src) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (src == source::AUTO || src == source::TSC) {
+                if (calibrate()) { _source.store(source::TSC, std::memory_order_release); return; }
+                src = source::AUTO;
+            }
+            if (src == source::AUTO) src = fastRealtime() ? source::REALTIME : source::REALTIME_COARSE;
+            if (src == source::MONOTONIC) _offset.store(clockNs(CLOCK_REALTIME) - clockNs(CLOCK_MONOTONIC), std::memory_order_relaxed);
+            _source.store(src, std::memory_order_release);
+        }
+        // 测量 CLOCK_REALTIME 的平均读取开销（虚拟机上可能退化为系统调用）
+        static bool fastRealtime() {
+            const int rounds = 1000;
+            int64_t begin = clockNs(CLOCK_MONOTONIC);
+            for (int i = 0; i < rounds; ++i) clockNs(CLOCK_REALTIME);
+            return (clockNs(CLOCK_MONOTONIC) - begin) / rounds < CLOCK_FAST_CALL_NS;
+        }
+#ifdef MYLOG_HAVE_TSC
+        // 检查恒定频率 TSC（CPUID 0x80000007 EDX 第 8 位），并以 CLOCK_REALTIME 校准频率
+        bool calibrate() {
+            unsigned int eax, ebx, ecx, edx;
+            if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0 || (edx & (1u << 8)) == 0) return false;
+            uint64_t t0;
+            int64_t r0 = sample(t0);
+            uint64_t t1;
+            int64_t r1;
+            do { r1 = sample(t1); } while (r1 - r0 < CLOCK_CALIBRATE_NS);
+            if (t1 <= t0) return false;
+            double ns_per_tick = (double)(r1 - r0) / (double)(t1 - t0);
+            // 已在使用 TSC 时，读取线程可能正在重新校准，等待其完成后再发布
+            bool expected = false;
+            while (_resyncing.compare_exchange_weak(expected, true, std::memory_order_acquire) == false) {
+                expected = false;
+                std::this_thread::yield();
+            }
+            publish(t1, r1, ns_per_tick);
+            _sample_tsc = t1;
+            _sample_ns = r1;
+            _rate = ns_per_tick;
+            // 启动时的采样较短，先以较短的间隔重新校准，之后逐次加倍直到 CLOCK_RESYNC_NS
+            _resync_ticks.store((uint64_t)(CLOCK_CALIBRATE_NS * 10 / ns_per_tick), std::memory_order_relaxed);
+            _max_resync_ticks.store((uint64_t)(CLOCK_RESYNC_NS / ns_per_tick), std::memory_order_relaxed);
+            _resyncing.store(false, std::memory_order_release);
+            return true;
+        }
+        // 同时读取 TSC 与墙上时间，TSC 取 clock_gettime 前后的中点
+        static int64_t sample(uint64_t &tsc) {
+            uint64_t before = __rdtsc();
+            int64_t ns = clockNs(CLOCK_REALTIME);
+            uint64_t after = __rdtsc();
+            tsc = before + (after - before) / 2;
+            return ns;
+        }
+        int64_t readTsc() {
+            uint64_t tsc = __rdtsc();
+            uint64_t base_tsc;
+            int64_t base_ns;
+            double ns_per_tick;
+            uint32_t seq;
+            do {
+                seq = _seq.load(std::memory_order_acquire);
+                base_tsc = _base_tsc.load(std::memory_order_relaxed);
+                base_ns = _base_ns.load(std::memory_order_relaxed);
+                ns_per_tick = _ns_per_tick.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while ((seq & 1) || seq != _seq.load(std::memory_order_relaxed));
+            if (tsc > base_tsc && tsc - base_tsc > _resync_ticks.load(std::memory_order_relaxed) && resync(base_tsc, base_ns)) return readTsc();
+            return base_ns + (int64_t)((int64_t)(tsc - base_tsc) * ns_per_tick);
+        }
+        // 以上次采样与当前的采样重新计算频率，同一时刻只有一个线程执行，其他线程继续使用原参数
+        // 1. 新的校准点不早于按原参数推算的时间，时间戳不会因校准而回退
+        // 2. 墙上时间落后时从推算值开始，以较低的速率在下一个间隔内追平；速率最多降低一半，
+        //    墙上时间被大幅回拨时在之后的多次校准中逐步追平
+        // 3. 频率总是以真实的采样计算，不受发布参数的调整影响
+        bool resync(uint64_t base_tsc, int64_t base_ns) {
+            bool expected = false;
+            if (_resyncing.compare_exchange_strong(expected, true, std::memory_order_acquire) == false) return false;
+            bool done = false;
+            uint64_t tsc;
+            int64_t ns = sample(tsc);
+            if (_base_tsc.load(std::memory_order_relaxed) == base_tsc && tsc > base_tsc && tsc > _sample_tsc) {
+                // 墙上时间不晚于上次采样时（被回拨）无法测量频率，沿用原频率
+                if (ns > _sample_ns) _rate = (double)(ns - _sample_ns) / (double)(tsc - _sample_tsc);
+                _sample_tsc = tsc;
+                _sample_ns = ns;
+                int64_t expect = base_ns + (int64_t)((double)(tsc - base_tsc) * _ns_per_tick.load(std::memory_order_relaxed));
+                uint64_t ticks = _resync_ticks.load(std::memory_order_relaxed) * 2;
+                uint64_t max_ticks = _max_resync_ticks.load(std::memory_order_relaxed);
+                if (ticks > max_ticks) ticks = max_ticks;
+                double rate = _rate;
+                if (ns < expect) {
+                    double slew = (double)(ns + (int64_t)((double)ticks * _rate) - expect) / (double)ticks;
+                    rate = slew > _rate / 2 ? slew : _rate / 2;
+                    ns = expect;
+                }
+                publish(tsc, ns, rate);
+                _resync_ticks.store(ticks, std::memory_order_relaxed);
+                done = true;
+            }
+            _resyncing.store(false, std::memory_order_release);
+            return done;
+        }
+        // 发布换算参数（持有 _resyncing 时调用）
+        void publish(uint64_t tsc, int64_t ns, double ns_per_tick) {
+            uint32_t seq = _seq.load(std::memory_order_relaxed);
+            _seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            _base_tsc.store(tsc, std::memory_order_relaxed);
+            _base_ns.store(ns, std::memory_order_relaxed);
+            _ns_per_tick.store(ns_per_tick, std::memory_order_relaxed);
+            _seq.store(seq + 2, std::memory_order_release);
+        }
+#else
+        bool calibrate() { return false; }
+#endif
+    private:
+        std::atomic<source> _source;
+        std::mutex _mutex;                  // 串行化 init
+        std::atomic<uint32_t> _seq;         // 顺序锁：奇数表示正在更新换算参数
+        std::atomic<bool> _resyncing;       // 是否有线程正在重新校准
+        std::atomic<uint64_t> _base_tsc;    // 校准点的 TSC
+        std::atomic<int64_t> _base_ns;      // 校准点的墙上时间
+        std::atomic<double> _ns_per_tick;
+        std::atomic<uint64_t> _resync_ticks; // 距校准点超过该值时重新校准
+        std::atomic<uint64_t> _max_resync_ticks;
+        std::atomic<int64_t> _offset;       // MONOTONIC 与墙上时间的偏移
+        uint64_t _sample_tsc;               // 上次校准时的真实采样与测得的频率（持有 _resyncing 时访问）
+        int64_t _sample_ns;
+        double _rate;
+    };
+}
+
+#endif /* __M_CLOCK_H__ */
@@ -0,0 +1,97 @@
+#ifndef __M_COMBINER_H__
+#define __M_COMBINER_H__
+/*
+    平面合并（flat combining）：同步日志器的多个线程同时写入时，合并为一次落地
+    1. 每个线程将格式化好的日志发布到自己栈上的槽位中，槽位以无锁方式挂到发布链表上
+    2. 获得合并锁的线程（合并者）取走整个发布链表，按发布顺序将各槽位的数据以多段内存一次交给落地模块（不拼接），再逐个标记槽位完成
+    3. 其余线程等待自己的槽位完成，期间不断尝试成为合并者，因此不会有槽位被遗漏
+    4. 每个落地模块组各有一个合并者，落地时只加落地模块自身的锁，不同的组、不同的落地模块互不阻塞
+*/
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <sys/uio.h>
+#include "sink.hpp"
+
+namespace mylog {
+
+    #define COMBINE_SPIN 64 // 等待槽位完成时，让出 CPU 之前自旋的次数
+
+    class Combiner {
+    public:
+        Combiner(): _head(nullptr) {}
+        // 将一条日志写入该组的所有落地模块，返回时日志已经落地（可能由其他线程代为落地）
+        void write(const SinkGroup &group, const LogRecord &rec, const LogBatch &batch) {
+            Slot slot(rec, batch);
+            Slot *head = _head.load(std::memory_order_relaxed);
+            do {
+                slot._next = head;
+            } while (!_head.compare_exchange_weak(head, &slot, std::memory_order_release, std::memory_order_relaxed));
+            size_t spins = 0;
+            while (slot._done.load(std::memory_order_acquire) == false) {
+                if (_mutex.try_lock()) {
+                    combine(group);
+                    _mutex.unlock();
+                } else if (++spins > COMBINE_SPIN) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        // fork 之前持有合并锁，等待正在进行的合并完成
+        void prepareFork() { _mutex.lock(); }
+        // 子进程中发布链表上的槽位属于父进程中等待的线程（由父进程落地），直接丢弃
+        void afterFork(bool child) {
+            if (child) _head.store(nullptr, std::memory_order_relaxed);
+            _mutex.unlock();
+        }
+    private:
+        struct Slot {
+            LogRecord _rec;
+            const LogBatch &_batch;
+            Slot *_next;
+            std::atomic<bool> _done;
+            Slot(const LogRecord &rec, const LogBatch &batch):
+                _rec(rec), _batch(batch), _next(nullptr), _done(false) {}
+        };
+        void combine(const SinkGroup &group) {
+            Slot *list = _head.exchange(nullptr, std::memory_order_acquire);
+            if (list == nullptr) return;
+            // 发布链表是后进先出的，反转为发布顺序
+            Slot *first = nullptr;
+            while (list != nullptr) {
+                Slot *next = list->_next;
+                list->_next = first;
+                first = list;
+                list = next;
+            }
+            // 各槽位的数据作为一批（只有一条日志时直接落地）；组内有落地模块需要逐条信息时一并整理每条日志
+            LogBatch batch = first->_batch;
+            _iov.clear();
+            _recs.clear();
+            for (Slot *s = first; s != nullptr; s = s->_next) {
+                struct iovec iov;
+                iov.iov_base = (void *)s->_rec._data;
+                iov.iov_len = s->_rec._len;
+                _iov.push_back(iov);
+                if (group._records) _recs.push_back(s->_rec);
+                if (s != first) batch.merge(s->_batch);
+            }
+            group.write(_iov.data(), _iov.size(), _recs.data(), _recs.size(), batch);
+            // 标记完成之后槽位所在的栈帧随时可能失效，须先取出下一个槽位
+            while (first != nullptr) {
+                Slot *next = first->_next;
+                first->_done.store(true, std::memory_order_release);
+                first = next;
+            }
+        }
+    private:
+        std::mutex _mutex;          // 合并锁，持有者即合并者
+        std::atomic<Slot *> _head;  // 发布链表
+        std::vector<struct iovec> _iov; // 合并者交给落地模块的各段数据（受合并锁保护）
+        std::vector<LogRecord> _recs;   // 各段数据对应的日志（受合并锁保护）
+    };
+}
+
+#endif /* __M_COMBINER_H__ */
@@ -0,0 +1,131 @@
+#ifndef __M_CONTEXT_H__
+#define __M_CONTEXT_H__
+/*
+    线程上下文：每个线程初始化一次，日志格式化时直接拷贝预先生成的文本
+    1. 内核线程ID与线程名称（%t / %N）
+    2. 诊断上下文键值对（%X{key}），如 request_id、tenant，由 ContextGuard 在作用域内压入与弹出
+    3. 所有内容连续保存在一段字节中，日志消息只记录指针与长度；异步记录模式下整段拷贝进记录
+       编码：[tid 长度 1B][tid][名称长度 1B][名称]{[键长度 1B][键][值长度 2B][值]}*
+*/
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+namespace mylog {
+    class ThreadContext {
+    public:
+        // 当前线程的上下文
+        static ThreadContext &local() {
+            static thread_local ThreadContext ctx;
+            return ctx;
+        }
+        // 设置当前线程在日志中显示的名称，已压入的键值对保持不变
+        void setName(const std::string &name) {
+            std::string mdc = _data.substr(_prefix_len);
+            _name = name.substr(0, UINT8_MAX);
+            render();
+            _data.append(mdc);
+        }
+        const std::string &name() const { return _name; }
+        // fork 之后的子进程中调用：调用 fork 的线程在子进程中有新的线程ID
+        void refreshTid() {
+            std::string mdc = _data.substr(_prefix_len);
+            _tid = syscall(SYS_gettid);
+            render();
+            _data.append(mdc);
+        }
+        pid_t tid() const { return _tid; }
+        const char *data() const { return _data.data(); }
+        size_t size() const { return _data.size(); }
+        // 压入一个键值对，返回压入之前键值对部分的长度，用于弹出
+        size_t push(const char *key, size_t klen, const char *val, size_t vlen) {
+            size_t mark = _data.size() - _prefix_len;
+            uint8_t k = klen > UINT8_MAX ? UINT8_MAX : klen;
+            uint16_t v = vlen > UINT16_MAX ? UINT16_MAX : vlen;
+            _data.push_back((char)k);
+            _data.append(key, k);
+            _data.append((const char *)&v, sizeof(v));
+            _data.append(val, v);
+            return mark;
+        }
+        void pop(size_t mark) { _data.resize(_prefix_len + mark); }
+
+        // 以下接口解析上下文编码，可用于其他线程拷贝的上下文（如异步记录）
+        static void tid(const char *ctx, size_t len, const char **str, size_t *n) {
+            *n = len > 0 ? (uint8_t)ctx[0] : 0;
+            *str = ctx + 1;
+        }
+        static void name(const char *ctx, size_t len, const char **str, size_t *n) {
+            *n = 0;
+            if (len == 0) return;
+            const char *p = ctx + 1 + (uint8_t)ctx[0];
+            *n = (uint8_t)p[0];
+            *str = p + 1;
+        }
+        // 查找键对应的值，同名的键以最后压入的为准
+        static bool find(const char *ctx, size_t len, const char *key, size_t klen, const char **val, size_t *vlen) {
+            if (len == 0) return false;
+            const char *p = ctx + 1 + (uint8_t)ctx[0];
+            p += 1 + (uint8_t)p[0];
+            const char *end = ctx + len;
+            bool found = false;
+            while (p < end) {
+                uint8_t k = (uint8_t)*p++;
+                const char *kp = p;
+                p += k;
+                uint16_t v;
+                memcpy(&v, p, sizeof(v));
+                p += sizeof(v);
+                if (k == klen && memcmp(kp, key, klen) == 0) {
+                    *val = p;
+                    *vlen = v;
+                    found = true;
+                }
+                p += v;
+            }
+            return found;
+        }
+    private:
+        ThreadContext(): _tid(syscall(SYS_gettid)), _prefix_len(0) {
+            // 默认名称为创建线程时继承的名称（主线程为进程名）
+            char buf[32] = {0};
+            pthread_getname_np(pthread_self(), buf, sizeof(buf));
+            _name = buf;
+            render();
+        }
+        void render() {
+            std::string tid = std::to_string(_tid);
+            _data.clear();
+            _data.push_back((char)tid.size());
+            _data.append(tid);
+            _data.push_back((char)_name.size());
+            _data.append(_name);
+            _prefix_len = _data.size();
+        }
+    private:
+        pid_t _tid;
+        std::string _name;
+        std::string _data;  // 预先生成的上下文编码
+        size_t _prefix_len; // tid 与名称部分的长度
+    };
+
+    // 在作用域内为当前线程压入一个诊断上下文键值对：ContextGuard guard("request_id", id);
+    class ContextGuard {
+    public:
+        ContextGuard(const char *key, const std::string &val):
+            _mark(ThreadContext::local().push(key, strlen(key), val.data(), val.size())) {}
+        ContextGuard(const char *key, const char *val):
+            _mark(ThreadContext::local().push(key, strlen(key), val, strlen(val))) {}
+        ~ContextGuard() { ThreadContext::local().pop(_mark); }
+        ContextGuard(const ContextGuard &) = delete;
+        ContextGuard &operator=(const ContextGuard &) = delete;
+    private:
+        size_t _mark;
+    };
+}
+
+#endif /* __M_CONTEXT_H__ */
@@ -0,0 +1,83 @@
+#ifndef __M_FIELD_H__
+#define __M_FIELD_H__
+/*
+    结构化日志的键值对字段
+    1. kv("id", 42) 生成的字段只保存键的指针与值（字符串同样只保存指针与长度），不产生内存分配
+    2. 字段只在一次日志调用期间有效，日志器在调用返回前完成格式化或拷贝
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace mylog {
+    struct Field {
+        enum class type : uint8_t {
+            INT,
+            UINT,
+            DOUBLE,
+            BOOL,
+            STRING
+        };
+        union Value {
+            int64_t _int;
+            uint64_t _uint;
+            double _double;
+            bool _bool;
+            const char *_str;
+        };
+        const char *_key;
+        size_t _key_len;
+        type _type;
+        Value _value;
+        size_t _len; // STRING 类型的值长度
+
+        Field(const char *key, type t): _key(key), _key_len(strlen(key)), _type(t), _len(0) {}
+        Field(): _key(""), _key_len(0), _type(type::INT), _len(0) { _value._int = 0; }
+    };
+
+    // 有符号整数
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, Field>::type
+    kv(const char *key, T val) {
+        Field field(key, Field::type::INT);
+        field._value._int = val;
+        return field;
+    }
+    // 无符号整数
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, Field>::type
+    kv(const char *key, T val) {
+        Field field(key, Field::type::UINT);
+        field._value._uint = val;
+        return field;
+    }
+    // 浮点数
+    template<typename T>
+    typename std::enable_if<std::is_floating_point<T>::value, Field>::type
+    kv(const char *key, T val) {
+        Field field(key, Field::type::DOUBLE);
+        field._value._double = val;
+        return field;
+    }
+    inline Field kv(const char *key, bool val) {
+        Field field(key, Field::type::BOOL);
+        field._value._bool = val;
+        return field;
+    }
+    inline Field kv(const char *key, const char *val, size_t len) {
+        Field field(key, Field::type::STRING);
+        field._value._str = val;
+        field._len = len;
+        return field;
+    }
+    inline Field kv(const char *key, const char *val) {
+        return kv(key, val, strlen(val));
+    }
+    inline Field kv(const char *key, const std::string &val) {
+        return kv(key, val.data(), val.size());
+    }
+}
+
+#endif /* __M_FIELD_H__ */
@@ -6,10 +6,109 @@
 #include <vector>
 #include <sstream>
 #include <ctime>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "level.hpp"
 #include "message.hpp"
 
 namespace mylog {
+    // 结构化输出的字符串转义，直接写入输出流，不产生中间字符串
+    class Escape {
+    public:
+        // 输出 JSON 字符串（含两侧引号）
+        static void json(std::ostream &out, const char *str, size_t len) {
+            out.put('"');
+            escape(out, str, len, false);
+            out.put('"');
+        }
+        // 输出 logfmt 的值：不含空格、等号、引号与控制字符时原样输出，否则加引号并转义
+        static void logfmt(std::ostream &out, const char *str, size_t len) {
+            if (len > 0 && findSpecial(str, len, 0, true) == len) {
+                out.write(str, len);
+                return;
+            }
+            json(out, str, len);
+        }
+        // 输出单个字段的值
+        static void value(std::ostream &out, const Field &field, bool logfmt) {
+            char tmp[32];
+            int n = 0;
+            switch (field._type) {
+                case Field::type::INT: n = snprintf(tmp, sizeof(tmp), "%lld", (long long)field._value._int); break;
+                case Field::type::UINT: n = snprintf(tmp, sizeof(tmp), "%llu", (unsigned long long)field._value._uint); break;
+                case Field::type::BOOL: out << (field._value._bool ? "true" : "false"); return;
+                case Field::type::DOUBLE:
+                    // JSON 不支持 NaN 与无穷大
+                    if (std::isfinite(field._value._double) == false) { out << "null"; return; }
+                    n = snprintf(tmp, sizeof(tmp), "%.17g", field._value._double);
+                    break;
+                case Field::type::STRING:
+                    if (logfmt) Escape::logfmt(out, field._value._str, field._len);
+                    else Escape::json(out, field._value._str, field._len);
+                    return;
+            }
+            out.write(tmp, n);
+        }
+    private:
+        // 从 pos 开始查找第一个需要转义的字符，没有则返回 len
+        // 支持 SSE2 时每次检查 16 字节
+        static size_t findSpecial(const char *str, size_t len, size_t pos, bool logfmt) {
+#ifdef __SSE2__
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i slash = _mm_set1_epi8('\\');
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i equal = _mm_set1_epi8('=');
+            const __m128i ctrl = _mm_set1_epi8((char)0xE0);
+            const __m128i zero = _mm_setzero_si128();
+            while (pos + 16 <= len) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(str + pos));
+                __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash));
+                // 高三位全为 0 即小于 0x20 的控制字符
+                hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_and_si128(v, ctrl), zero));
+                if (logfmt) hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, equal)));
+                int mask = _mm_movemask_epi8(hit);
+                if (mask != 0) return pos + __builtin_ctz(mask);
+                pos += 16;
+            }
+#endif
+            for (; pos < len; ++pos) {
+                unsigned char c = str[pos];
+                if (c == '"' || c == '\\' || c < 0x20) return pos;
+                if (logfmt && (c == ' ' || c == '=')) return pos;
+            }
+            return len;
+        }
+        static void escape(std::ostream &out, const char *str, size_t len, bool logfmt) {
+            static const char hex[] = "0123456789abcdef";
+            size_t start = 0;
+            while (start < len) {
+                size_t pos = findSpecial(str, len, start, logfmt);
+                out.write(str + start, pos - start);
+                if (pos == len) break;
+                unsigned char c = str[pos];
+                switch (c) {
+                    case '"': out.write("\\\"", 2); break;
+                    case '\\': out.write("\\\\", 2); break;
+                    case '\n': out.write("\\n", 2); break;
+                    case '\r': out.write("\\r", 2); break;
+                    case '\t': out.write("\\t", 2); break;
+                    default:
+                        if (c < 0x20) {
+                            char tmp[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                            out.write(tmp, 6);
+                        } else {
+                            out.put(c); // logfmt 引号内的空格与等号无需转义
+                        }
+                }
+                start = pos + 1;
+            }
+        }
+    };
+
     // 抽象格式化子项基类
     class FormatItem {
     public:
@@ -19,7 +118,9 @@ namespace mylog {
     // 派生格式化子项子类 -- 消息，等级，时间，文件名，行号，线程ID，日志器名，制表符，换行，其他
     /*
     %d 表示日期，包含子格式 {%H:%M:%S}
-    %t 表示线程ID
+    %t 表示线程ID（内核线程ID）
+    %N 表示线程名称
+    %X 表示诊断上下文字段，包含子格式 {key}
     %c 表示日志器名称
     %f 表示源码文件名
     %l 表示源码行号
@@ -27,11 +128,14 @@ namespace mylog {
     %T 表示制表符缩进
     %m 表示主题消息
     %n 表示换行
+    %K 表示结构化字段，以 logfmt 形式输出 k1=v1 k2=v2
+    %J 表示以 JSON 对象输出整条日志（包含结构化字段）
+    %L 表示以 logfmt 形式输出整条日志（包含结构化字段）
     */
     class MsgFormatItem : public FormatItem {
     public:
         void format(std::ostream &out, const LogMsg &msg) override {
-            out << msg._payload;
+            out.write(msg._payload, msg._payload_len);
         }        
     };
     class LevelFormatItem : public FormatItem {
@@ -40,23 +144,65 @@ namespace mylog {
             out << LogLevel::toString(msg._level);
         }        
     };
+    // 时间：strftime 格式，另外支持 %3N / %6N / %9N（%N 同 %9N）输出秒的小数部分（毫秒 / 微秒 / 纳秒）
     class TimeFormatItem : public FormatItem {
     public:
-        TimeFormatItem(const std::string &fmt = "%H:%M:%S"): _time_fmt(fmt) {}
+        TimeFormatItem(const std::string &fmt = "%H:%M:%S") { parse(fmt.empty() ? "%H:%M:%S" : fmt); }
         void format(std::ostream &out, const LogMsg &msg) override {
+            char tmp[64];
+            out.write(tmp, render(tmp, sizeof(tmp), msg));
+        }
+        // 将时间写入 buf，返回写入的长度
+        size_t render(char *buf, size_t cap, const LogMsg &msg) const {
             struct tm t;
             localtime_r(&msg._ctime, &t);
-            char tmp[32] = {0};
-            strftime(tmp, 31, _time_fmt.c_str(),  &t);
-            out << tmp;
+            size_t n = 0;
+            for (auto &seg : _segments) {
+                if (seg._strf.empty() == false) n += strftime(buf + n, cap - n, seg._strf.c_str(), &t);
+                if (seg._digits > 0 && cap - n > (size_t)seg._digits) {
+                    int64_t frac = msg._ns % NS_PER_SEC;
+                    for (int i = seg._digits; i < 9; ++i) frac /= 10;
+                    for (int i = seg._digits - 1; i >= 0; --i, frac /= 10) buf[n + i] = '0' + frac % 10;
+                    n += seg._digits;
+                }
+            }
+            return n;
+        }
+    private:
+        // 以小数部分为界切分格式：每段为一段 strftime 格式加上其后的小数位数（0 表示没有）
+        void parse(const std::string &fmt) {
+            Segment seg;
+            seg._digits = 0;
+            for (size_t i = 0; i < fmt.size(); ++i) {
+                if (fmt[i] == '%' && i + 1 < fmt.size()) {
+                    size_t j = i + 1;
+                    int digits = 0;
+                    if (fmt[j] >= '1' && fmt[j] <= '9') digits = fmt[j++] - '0';
+                    if (j < fmt.size() && fmt[j] == 'N') {
+                        seg._digits = digits == 0 ? 9 : digits;
+                        _segments.push_back(seg);
+                        seg._strf.clear();
+                        seg._digits = 0;
+                        i = j;
+                        continue;
+                    }
+                    seg._strf.push_back(fmt[i++]); // 其余转换（包括 %%）原样交给 strftime
+                }
+                seg._strf.push_back(fmt[i]);
+            }
+            if (seg._strf.empty() == false) _segments.push_back(seg);
         }
     private:
-        std::string _time_fmt; // %H:%M:%S        
+        struct Segment {
+            std::string _strf;
+            int _digits;
+        };
+        std::vector<Segment> _segments;
     };
     class FileFormatItem : public FormatItem {
     public:
         void format(std::ostream &out, const LogMsg &msg) override {
-            out << msg._file;
+            out.write(msg._file, msg._file_len);
         }        
     };
     class LineFormatItem : public FormatItem {
@@ -65,16 +211,45 @@ namespace mylog {
             out << msg._line;
         }        
     };
+    // 线程ID：输出线程上下文中预先生成的内核线程ID
     class ThreadFormatItem : public FormatItem {
     public:
         void format(std::ostream &out, const LogMsg &msg) override {
-            out << msg._tid;
+            write(out, msg);
         }        
+        static void write(std::ostream &out, const LogMsg &msg) {
+            if (msg._context_len == 0) { out << msg._tid; return; }
+            const char *str = ""; size_t n = 0;
+            ThreadContext::tid(msg._context, msg._context_len, &str, &n);
+            out.write(str, n);
+        }
+    };
+    // 线程名称
+    class ThreadNameFormatItem : public FormatItem {
+    public:
+        void format(std::ostream &out, const LogMsg &msg) override {
+            const char *str = ""; size_t n = 0;
+            ThreadContext::name(msg._context, msg._context_len, &str, &n);
+            out.write(str, n);
+        }
+    };
+    // 诊断上下文字段：%X{request_id}，当前线程没有该字段时不输出
+    class ContextFormatItem : public FormatItem {
+    public:
+        ContextFormatItem(const std::string &key): _key(key) {}
+        void format(std::ostream &out, const LogMsg &msg) override {
+            const char *val = ""; size_t n = 0;
+            if (ThreadContext::find(msg._context, msg._context_len, _key.data(), _key.size(), &val, &n)) {
+                out.write(val, n);
+            }
+        }
+    private:
+        std::string _key;
     };
     class LoggerFormatItem : public FormatItem {
     public:
         void format(std::ostream &out, const LogMsg &msg) override {
-            out << msg._logger;
+            out.write(msg._logger, msg._logger_len);
         }        
     };
     class TabFormatItem : public FormatItem {
@@ -89,6 +264,71 @@ namespace mylog {
             out << "\n";
         }        
     };
+    class KvFormatItem : public FormatItem {
+    public:
+        void format(std::ostream &out, const LogMsg &msg) override {
+            for (size_t i = 0; i < msg._field_count; ++i) {
+                const Field &field = msg._fields[i];
+                if (i > 0) out.put(' ');
+                out.write(field._key, field._key_len);
+                out.put('=');
+                Escape::value(out, field, true);
+            }
+        }
+    };
+    class JsonFormatItem : public FormatItem {
+    public:
+        JsonFormatItem(const std::string &fmt): _time(fmt.empty() ? "%Y-%m-%dT%H:%M:%S" : fmt) {}
+        void format(std::ostream &out, const LogMsg &msg) override {
+            char tmp[64];
+            size_t n = _time.render(tmp, sizeof(tmp), msg);
+            out << "{\"time\":";
+            Escape::json(out, tmp, n);
+            out << ",\"level\":\"" << LogLevel::toString(msg._level) << "\",\"logger\":";
+            Escape::json(out, msg._logger, msg._logger_len);
+            out << ",\"file\":";
+            Escape::json(out, msg._file, msg._file_len);
+            out << ",\"line\":" << msg._line << ",\"tid\":\"";
+            ThreadFormatItem::write(out, msg);
+            out << "\",\"msg\":";
+            Escape::json(out, msg._payload, msg._payload_len);
+            for (size_t i = 0; i < msg._field_count; ++i) {
+                const Field &field = msg._fields[i];
+                out.put(',');
+                Escape::json(out, field._key, field._key_len);
+                out.put(':');
+                Escape::value(out, field, false);
+            }
+            out.put('}');
+        }
+    private:
+        TimeFormatItem _time;
+    };
+    class LogfmtFormatItem : public FormatItem {
+    public:
+        LogfmtFormatItem(const std::string &fmt): _time(fmt.empty() ? "%Y-%m-%dT%H:%M:%S" : fmt) {}
+        void format(std::ostream &out, const LogMsg &msg) override {
+            char tmp[64];
+            size_t n = _time.render(tmp, sizeof(tmp), msg);
+            out << "time=";
+            Escape::logfmt(out, tmp, n);
+            out << " level=" << LogLevel::toString(msg._level) << " logger=";
+            Escape::logfmt(out, msg._logger, msg._logger_len);
+            out << " file=";
+            Escape::logfmt(out, msg._file, msg._file_len);
+            out << " line=" << msg._line << " tid=";
+            ThreadFormatItem::write(out, msg);
+            out << " msg=";
+            Escape::logfmt(out, msg._payload, msg._payload_len);
+            if (msg._field_count > 0) {
+                out.put(' ');
+                _kv.format(out, msg);
+            }
+        }
+    private:
+        TimeFormatItem _time;
+        KvFormatItem _kv;
+    };
     // abcdefg[%d{%H}]
     class OtherFormatItem : public FormatItem {
     public:
@@ -100,6 +340,51 @@ namespace mylog {
         std::string _str;
     };
 
+    // 可复用的格式化输出缓冲：写入连续的字符数组，reset 后保留容量，取结果不产生字符串拷贝
+    class LogStreamBuf : public std::streambuf {
+    public:
+        LogStreamBuf() { _buf.resize(256); resetPut(0); }
+        const char *data() const { return pbase(); }
+        size_t size() const { return pptr() - pbase(); }
+        void reset() { resetPut(0); }
+    protected:
+        int_type overflow(int_type ch) override {
+            if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+            grow(1);
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+            return ch;
+        }
+        std::streamsize xsputn(const char *s, std::streamsize n) override {
+            if (epptr() - pptr() < n) grow(n);
+            memcpy(pptr(), s, n);
+            pbump(static_cast<int>(n));
+            return n;
+        }
+    private:
+        void grow(size_t need) {
+            size_t used = size();
+            size_t cap = _buf.size();
+            while (cap - used < need) cap *= 2;
+            _buf.resize(cap);
+            resetPut(used);
+        }
+        void resetPut(size_t used) {
+            setp(_buf.data(), _buf.data() + _buf.size());
+            pbump(static_cast<int>(used));
+        }
+    private:
+        std::vector<char> _buf;
+    };
+    class LogStream : public std::ostream {
+    public:
+        LogStream(): std::ostream(nullptr) { rdbuf(&_buf); }
+        const char *data() const { return _buf.data(); }
+        size_t size() const { return _buf.size(); }
+        void reset() { _buf.reset(); clear(); }
+    private:
+        LogStreamBuf _buf;
+    };
 
     class Formatter {
     public:
@@ -119,6 +404,7 @@ namespace mylog {
             format(ss, msg);
             return ss.str();
         }
+        const std::string &pattern() const { return _pattern; }
     private:
         // 对格式化规则字符串进行解析
         bool parsePattern() {
@@ -179,6 +465,8 @@ namespace mylog {
 
             if (key == "d") return std::make_shared<TimeFormatItem>(val);
             if (key == "t") return std::make_shared<ThreadFormatItem>();
+            if (key == "N") return std::make_shared<ThreadNameFormatItem>();
+            if (key == "X") return std::make_shared<ContextFormatItem>(val);
             if (key == "c") return std::make_shared<LoggerFormatItem>();
             if (key == "f") return std::make_shared<FileFormatItem>();
             if (key == "l") return std::make_shared<LineFormatItem>();
@@ -186,6 +474,9 @@ namespace mylog {
             if (key == "T") return std::make_shared<TabFormatItem>();
             if (key == "m") return std::make_shared<MsgFormatItem>();
             if (key == "n") return std::make_shared<NLineFormatItem>();
+            if (key == "K") return std::make_shared<KvFormatItem>();
+            if (key == "J") return std::make_shared<JsonFormatItem>(val);
+            if (key == "L") return std::make_shared<LogfmtFormatItem>(val);
             if (key == "")  return std::make_shared<OtherFormatItem>(val);
             std::cout << "没有对应的格式化字符：%" << key << std::endl;
             abort();
@@ -0,0 +1,134 @@
+#ifndef __M_INDEX_H__
+#define __M_INDEX_H__
+/*
+    日志文件的旁路索引：与日志文件同名加 .idx 后缀，记录每个数据块的概要信息
+    1. 连续写入的若干批日志合并为一个数据块（达到 INDEX_BLOCK_SIZE 或日志器变化时结束）
+    2. 每个数据块记录：起始偏移、长度、时间范围、包含的等级位图、日志器名称的哈希
+    3. 索引项定长，查询工具 mylog-query 可直接 mmap 索引文件，只扫描符合条件的数据块
+*/
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "level.hpp"
+
+namespace mylog {
+
+    #define INDEX_MAGIC 0x5844494D // "MIDX"
+    #define INDEX_VERSION 1
+    #define INDEX_BLOCK_SIZE (64 * 1024)
+    #define INDEX_SUFFIX ".idx"
+
+    // 一批日志的概要信息：时间范围、包含的等级与所属日志器
+    struct LogBatch {
+        time_t _min_time;
+        time_t _max_time;
+        uint32_t _levels; // 等级位图：1 << level
+        const std::string *_logger;
+
+        LogBatch(const std::string *logger = nullptr): _min_time(0), _max_time(0), _levels(0), _logger(logger) {}
+        void add(time_t ctime, LogLevel::value level) {
+            if (_levels == 0 || ctime < _min_time) _min_time = ctime;
+            if (_levels == 0 || ctime > _max_time) _max_time = ctime;
+            _levels |= 1u << (int)level;
+        }
+        void merge(const LogBatch &batch) {
+            if (batch.empty()) return;
+            if (empty() || batch._min_time < _min_time) _min_time = batch._min_time;
+            if (empty() || batch._max_time > _max_time) _max_time = batch._max_time;
+            _levels |= batch._levels;
+        }
+        bool empty() const { return _levels == 0; }
+        void clear() { _levels = 0; _min_time = _max_time = 0; }
+    };
+
+    struct IndexHeader {
+        uint32_t _magic;
+        uint32_t _version;
+    };
+    struct IndexEntry {
+        uint64_t _offset;   // 数据块在日志文件中的起始偏移
+        uint64_t _len;      // 数据块长度
+        int64_t _min_time;
+        int64_t _max_time;
+        uint32_t _levels;   // 等级位图
+        uint32_t _logger;   // 日志器名称的哈希
+    };
+
+    class IndexWriter {
+    public:
+        IndexWriter(): _fd(-1), _logger(0) {}
+        ~IndexWriter() { close(); }
+        // 打开日志文件对应的索引文件，offset 为日志文件当前的大小
+        bool open(const std::string &logfile, uint64_t offset) {
+            close();
+            std::string pathname = logfile + INDEX_SUFFIX;
+            _fd = ::open(pathname.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+            if (_fd < 0) return false;
+            struct stat st;
+            if (fstat(_fd, &st) == 0 && st.st_size == 0) {
+                IndexHeader hdr = { INDEX_MAGIC, INDEX_VERSION };
+                if (::write(_fd, &hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+            }
+            _entry._offset = offset;
+            _entry._len = 0;
+            _batch.clear();
+            return true;
+        }
+        // 记录一批已经写入日志文件的数据
+        void add(size_t len, const LogBatch &batch) {
+            if (_fd < 0) return;
+            uint32_t logger = batch._logger ? hash(batch._logger->data(), batch._logger->size()) : 0;
+            if (_entry._len > 0 && logger != _logger) flush();
+            _logger = logger;
+            _entry._len += len;
+            _batch.merge(batch);
+            if (_entry._len >= INDEX_BLOCK_SIZE) flush();
+        }
+        // 结束当前数据块，写入一条索引项
+        void flush() {
+            if (_fd < 0 || _entry._len == 0) return;
+            _entry._min_time = _batch._min_time;
+            _entry._max_time = _batch._max_time;
+            _entry._levels = _batch._levels;
+            _entry._logger = _logger;
+            ssize_t ret = ::write(_fd, &_entry, sizeof(_entry));
+            (void)ret;
+            _entry._offset += _entry._len;
+            _entry._len = 0;
+            _batch.clear();
+        }
+        void close() {
+            if (_fd < 0) return;
+            flush();
+            ::close(_fd);
+            _fd = -1;
+        }
+        // 不写入正在累积的数据块直接关闭（fork 之后的子进程中，该数据块由父进程写入）
+        void abandon() {
+            if (_fd < 0) return;
+            ::close(_fd);
+            _fd = -1;
+        }
+        // FNV-1a
+        static uint32_t hash(const char *data, size_t len) {
+            uint32_t h = 2166136261u;
+            for (size_t i = 0; i < len; ++i) {
+                h ^= (uint8_t)data[i];
+                h *= 16777619u;
+            }
+            return h;
+        }
+    private:
+        int _fd;
+        IndexEntry _entry; // 正在累积的数据块
+        LogBatch _batch;
+        uint32_t _logger;
+    };
+}
+
+#endif /* __M_INDEX_H__ */
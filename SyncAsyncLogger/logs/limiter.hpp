@@ -0,0 +1,301 @@
+#ifndef __M_LIMITER_H__
+#define __M_LIMITER_H__
+/*
+    调用点级别的限流与重复日志折叠
+    1. 令牌桶：每个调用点每秒最多输出 rate 条，允许 burst 条突发
+    2. 采样：每个调用点前 first 条全部输出，之后每 every 条输出一条
+    3. 折叠：连续相同的日志只输出一次，之后补一条 "last message repeated N times"
+       （遇到不同的日志、刷新、日志器析构或超过 LIMITER_REPEAT_IDLE_MS 没有新的日志时补充）
+    令牌桶与采样在任何格式化之前判断，被丢弃的日志几乎没有开销
+*/
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include "level.hpp"
+#include "thread.hpp"
+
+namespace mylog {
+
+    #define LIMITER_SLOT_COUNT 1024 // 调用点状态槽位数量，超出后的调用点不做限流
+    #define LIMITER_REPEAT_IDLE_MS 1000 // 折叠的日志之后超过该时长没有新的日志时，补充输出重复次数
+
+    struct LimitPolicy {
+        enum class type {
+            NONE,           // 不限流
+            TOKEN_BUCKET,   // 令牌桶
+            SAMPLE          // 前 first 条全部输出，之后每 every 条输出一条
+        };
+        type _type;
+        double _rate;   // 令牌桶：每秒补充的令牌数量
+        size_t _burst;  // 令牌桶：桶容量
+        size_t _first;  // 采样：全部输出的条数
+        size_t _every;  // 采样：之后每隔多少条输出一条
+        bool _dedup;    // 是否折叠连续相同的日志
+
+        LimitPolicy(): _type(type::NONE), _rate(0), _burst(0), _first(0), _every(1), _dedup(false) {}
+        static LimitPolicy tokenBucket(double rate, size_t burst) {
+            LimitPolicy policy;
+            policy._type = type::TOKEN_BUCKET;
+            policy._rate = rate;
+            policy._burst = burst == 0 ? 1 : burst;
+            return policy;
+        }
+        static LimitPolicy sample(size_t first, size_t every) {
+            LimitPolicy policy;
+            policy._type = type::SAMPLE;
+            policy._first = first;
+            policy._every = every == 0 ? 1 : every;
+            return policy;
+        }
+        static LimitPolicy dedup() {
+            LimitPolicy policy;
+            policy._dedup = true;
+            return policy;
+        }
+        // 在令牌桶/采样的基础上叠加折叠
+        LimitPolicy &withDedup() { _dedup = true; return *this; }
+    };
+
+    class RateLimiter {
+    public:
+        using ptr = std::shared_ptr<RateLimiter>;
+        // 折叠结束时需要补充输出的信息
+        struct Repeat {
+            size_t _count;
+            LogLevel::value _level;
+            std::string _file;
+            size_t _line;
+            Repeat(): _count(0), _level(LogLevel::value::UNKNOW), _line(0) {}
+        };
+        // 调用点状态：调用点第一次出现时占用一个槽位，策略只在此时查找一次
+        struct Site {
+            std::atomic<uint64_t> _key;   // 0 为空槽位，1 表示正在初始化
+            const char *_file;            // __FILE__ 的地址，与行号一起确认命中的是同一调用点
+            size_t _line;
+            const LimitPolicy *_policy;
+            std::atomic_flag _lock;
+            double _tokens;
+            uint64_t _last_ns;
+            size_t _count;
+            Site(): _key(0), _file(nullptr), _line(0), _policy(nullptr), _tokens(0), _last_ns(0), _count(0) { _lock.clear(); }
+        };
+        RateLimiter(): _sites(new Site[LIMITER_SLOT_COUNT]), _has_dedup(false), _dropped(0), _armed(false),
+            _last_site(nullptr), _last_level(LogLevel::value::UNKNOW), _last_line(0), _repeats(0), _repeat_ns(0) {}
+        // 以下两个设置接口只在日志器构建前由建造者调用
+        void setDefaultPolicy(const LimitPolicy &policy) {
+            _default = policy;
+            if (policy._dedup) _has_dedup = true;
+        }
+        void setPolicy(const std::string &file, size_t line, const LimitPolicy &policy) {
+            _policies[nameKey(file.c_str(), line)] = policy;
+            if (policy._dedup) _has_dedup = true;
+        }
+        // 查找调用点：以 __FILE__ 的地址与行号定位，不对文件名做哈希；槽位耗尽时返回空（不限流、不折叠）
+        // 同一源文件在不同编译单元中的 __FILE__ 通常由链接器合并为同一地址，未合并时各自占用一个槽位
+        Site *site(const char *file, size_t line) {
+            uint64_t k = ((uint64_t)(uintptr_t)file * 0x9E3779B97F4A7C15ull) ^ (line * 0xC2B2AE3D27D4EB4Full);
+            if (k < 2) k += 2;
+            size_t idx = k % LIMITER_SLOT_COUNT;
+            for (size_t i = 0; i < LIMITER_SLOT_COUNT; ++i) {
+                Site &site = _sites[(idx + i) % LIMITER_SLOT_COUNT];
+                uint64_t cur = site._key.load(std::memory_order_acquire);
+                if (cur == 0) {
+                    if (site._key.compare_exchange_strong(cur, 1, std::memory_order_acquire)) {
+                        site._file = file;
+                        site._line = line;
+                        site._policy = &policyOf(nameKey(file, line));
+                        site._key.store(k, std::memory_order_release);
+                        return &site;
+                    }
+                }
+                while (cur == 1) cur = site._key.load(std::memory_order_acquire);
+                if (cur == k && site._file == file && site._line == line) return &site;
+            }
+            return nullptr;
+        }
+        // 格式化之前调用：返回 false 表示该条日志被丢弃
+        bool allow(Site *site) {
+            if (site == nullptr) return true; // 槽位耗尽时放行，宁可多输出也不要丢日志
+            const LimitPolicy &policy = *site->_policy;
+            if (policy._type == LimitPolicy::type::NONE) return true;
+            bool pass = true;
+            SpinGuard guard(site->_lock);
+            if (policy._type == LimitPolicy::type::TOKEN_BUCKET) {
+                uint64_t now = nowNs();
+                if (site->_last_ns == 0) {
+                    site->_tokens = policy._burst;
+                } else {
+                    site->_tokens += (now - site->_last_ns) * policy._rate / 1e9;
+                    if (site->_tokens > policy._burst) site->_tokens = policy._burst;
+                }
+                site->_last_ns = now;
+                if (site->_tokens >= 1) site->_tokens -= 1;
+                else pass = false;
+            } else if (policy._type == LimitPolicy::type::SAMPLE) {
+                size_t n = site->_count++;
+                pass = (n < policy._first) || ((n - policy._first) % policy._every == 0);
+            }
+            if (!pass) _dropped.fetch_add(1, std::memory_order_relaxed);
+            return pass;
+        }
+        bool hasDedup() const { return _has_dedup; }
+        // 有效载荷生成之后、日志格式化之前调用
+        // 返回 false 表示与上一条日志相同，已被折叠；rep._count 非零时需要先补充输出上一条的重复次数
+        // 没有折叠策略的调用点只在上一条日志可以折叠时加锁（以结束折叠），其余情况不加锁、不比较正文
+        bool dedup(Site *site, LogLevel::value level, const char *file, size_t line, const char *payload, Repeat &rep) {
+            bool can_fold = site != nullptr && site->_policy->_dedup;
+            if (!can_fold && !_armed.load(std::memory_order_acquire)) return true;
+            std::unique_lock<std::mutex> lock(_dedup_mutex);
+            if (can_fold && site == _last_site && _last_level == level && _last_payload == payload) {
+                ++_repeats;
+                _repeat_ns = nowNs();
+                return false;
+            }
+            takeLocked(rep);
+            if (can_fold) {
+                _last_site = site;
+                _last_level = level;
+                _last_file = file;
+                _last_line = line;
+                _last_payload.assign(payload);
+            } else {
+                _last_site = nullptr;
+            }
+            _armed.store(can_fold, std::memory_order_release);
+            return true;
+        }
+        // 取出尚未输出的重复次数：idle_ns 为 0 时总是取出，否则只在最后一次重复之后超过 idle_ns 纳秒时取出
+        // 取出后同样的日志再次出现时重新开始折叠
+        bool takeRepeat(Repeat &rep, uint64_t idle_ns = 0) {
+            if (!_armed.load(std::memory_order_acquire)) return false;
+            std::unique_lock<std::mutex> lock(_dedup_mutex);
+            if (_repeats == 0 || (idle_ns > 0 && nowNs() - _repeat_ns < idle_ns)) return false;
+            takeLocked(rep);
+            return true;
+        }
+        // fork 期间持有所有调用点槽位与折叠状态的锁
+        void prepareFork() {
+            _dedup_mutex.lock();
+            for (size_t i = 0; i < LIMITER_SLOT_COUNT; ++i) {
+                while (_sites[i]._lock.test_and_set(std::memory_order_acquire)) {}
+            }
+        }
+        void afterFork() {
+            for (size_t i = 0; i < LIMITER_SLOT_COUNT; ++i) _sites[i]._lock.clear(std::memory_order_release);
+            _dedup_mutex.unlock();
+        }
+        // 被令牌桶或采样丢弃的日志总数
+        size_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+    private:
+        class SpinGuard {
+        public:
+            SpinGuard(std::atomic_flag &flag): _flag(flag) {
+                while (_flag.test_and_set(std::memory_order_acquire)) {}
+            }
+            ~SpinGuard() { _flag.clear(std::memory_order_release); }
+        private:
+            std::atomic_flag &_flag;
+        };
+        // 按文件名内容与行号查找策略的键，每个调用点只在占用槽位时计算一次
+        static uint64_t nameKey(const char *file, size_t line) {
+            return std::hash<std::string>()(file) * 31 + line;
+        }
+        const LimitPolicy &policyOf(uint64_t k) const {
+            auto it = _policies.find(k);
+            if (it == _policies.end()) return _default;
+            return it->second;
+        }
+        // 持有 _dedup_mutex 时调用
+        void takeLocked(Repeat &rep) {
+            if (_repeats == 0) return;
+            rep._count = _repeats;
+            rep._level = _last_level;
+            rep._file = _last_file;
+            rep._line = _last_line;
+            _repeats = 0;
+        }
+        static uint64_t nowNs() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    private:
+        std::unique_ptr<Site[]> _sites;
+        LimitPolicy _default;
+        std::unordered_map<uint64_t, LimitPolicy> _policies; // 构建后只读
+        bool _has_dedup;
+        std::atomic<size_t> _dropped;
+        // 折叠状态：日志器上最近一条可以折叠的日志（_armed 为假表示最近一条日志不可折叠）
+        std::atomic<bool> _armed;
+        std::mutex _dedup_mutex;
+        const Site *_last_site;
+        LogLevel::value _last_level;
+        std::string _last_file;
+        size_t _last_line;
+        std::string _last_payload;
+        size_t _repeats;
+        uint64_t _repeat_ns;  // 最后一次重复的时间
+    };
+
+    // 折叠的超时输出：连续相同的日志之后长时间没有新的日志时，由后台线程补充输出重复次数
+    // 1. 折叠连续相同日志的日志器由建造者登记，回调返回 false（日志器已析构）时移除
+    // 2. 回调在持有 _mutex 时运行；fork 时由日志管理器在获取日志器的锁之前获取 _mutex，子进程中重新启动后台线程
+    class RepeatTimer {
+    public:
+        using Callback = std::function<bool()>;
+        static RepeatTimer &instance() {
+            static RepeatTimer timer;
+            return timer;
+        }
+        void add(const Callback &cb) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _callbacks.push_back(cb);
+            if (!_thread.running()) _thread.start(std::bind(&RepeatTimer::threadEntry, this));
+        }
+        void prepareFork() { _mutex.lock(); }
+        void afterFork(bool child) {
+            if (child && _thread.running()) {
+                _cond.reinit();
+                _thread.reset();
+                _thread.start(std::bind(&RepeatTimer::threadEntry, this));
+            }
+            _mutex.unlock();
+        }
+    private:
+        RepeatTimer(): _stop(false) {}
+        ~RepeatTimer() {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+                _cond.notify_all();
+            }
+            _thread.join();
+        }
+        void threadEntry() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (!_stop) {
+                _cond.wait_for(lock, std::chrono::milliseconds(LIMITER_REPEAT_IDLE_MS / 2), [&]() { return _stop; });
+                if (_stop) break;
+                auto it = _callbacks.begin();
+                while (it != _callbacks.end()) {
+                    if ((*it)()) ++it;
+                    else it = _callbacks.erase(it);
+                }
+            }
+        }
+    private:
+        bool _stop;
+        std::mutex _mutex;
+        Cond _cond;
+        std::vector<Callback> _callbacks;
+        BackgroundThread _thread;
+    };
+}
+
+#endif /* __M_LIMITER_H__ */
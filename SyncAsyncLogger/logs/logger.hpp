@@ -13,11 +13,19 @@
 #include <mutex>
 #include <cstdarg>
 #include <unordered_map>
+#include <algorithm>
+#include <pthread.h>
 #include "util.hpp"
 #include "level.hpp"
 #include "format.hpp"
 #include "sink.hpp"
 #include "looper.hpp"
+#include "limiter.hpp"
+#include "backtrace.hpp"
+#include "record.hpp"
+#include "combiner.hpp"
+#include "rcu.hpp"
+#include "profiler.hpp"
 
 
 namespace mylog {
@@ -27,117 +35,148 @@ namespace mylog {
         Logger(const std::string &logger_name, 
             LogLevel::value level,
             Formatter::ptr &formatter,
-            std::vector<LogSink::ptr> &sinks):
+            std::vector<LogSink::ptr> &sinks,
+            const RateLimiter::ptr &limiter = RateLimiter::ptr(),
+            const Backtrace::ptr &backtrace = Backtrace::ptr(),
+            bool sync_fatal = false):
             _logger_name(logger_name),
             _limit_level(level),
             _formatter(formatter),
-            _sinks(sinks.begin(), sinks.end()) {}
+            _sinkset(new SinkSet(SinkGroup::group(formatter, sinks))),
+            _sink_level(_sinkset.load()->_sink_level),
+            _limiter(limiter),
+            _backtrace(backtrace),
+            _sync_fatal(sync_fatal) {}
+        virtual ~Logger() { delete _sinkset.load(); }
             const std::string &name() { return _logger_name; } 
         // 完成构造日志消息对象过程并进行格式化，得到格式化后的日志消息字符串 -- 然后进行落地输出
-        void debug(const std::string &file, size_t line, const std::string &fmt, ...) {
-            // 通过传入的参数构造出一个日志消息对象，进行日志的格式化，最终落地
-            // 1. 判断当前的日志是否达到了输出等级
-            if (LogLevel::value::DEBUG < _limit_level) { return ; }
-            // 2. 对 fmt 格式化字符串和不定参进行字符串组织，得到的日志消息的字符串
+        // file 须为静态存储的字符串（宏传入的 __FILE__），调用点以其地址与行号标识，回溯缓冲也只保存其指针；
+        // 传入 std::string::c_str() 等临时字符串时每次调用被当作新的调用点，限流与统计结果不正确
+        void debug(const char *file, size_t line, const std::string &fmt, ...) {
             va_list ap;
             va_start(ap, fmt);
-            char *res;
-            int ret = vasprintf(&res, fmt.c_str(), ap);
-            if (ret == -1) {
-                std::cout << "vasprintf failed!!\n";
-                return;
-            }
-            va_end(ap); // 将 ap 指针置空
-            serialize(LogLevel::value::DEBUG, file, line, res);
-            free(res);
-        }
-        void info(const std::string &file, size_t line, const std::string &fmt, ...) {
-                        // 通过传入的参数构造出一个日志消息对象，进行日志的格式化，最终落地
-            // 1. 判断当前的日志是否达到了输出等级
-            if (LogLevel::value::INFO < _limit_level) { return ; }
-            // 2. 对 fmt 格式化字符串和不定参进行字符串组织，得到的日志消息的字符串
+            logv(LogLevel::value::DEBUG, file, line, fmt, ap);
+            va_end(ap);
+        }
+        void info(const char *file, size_t line, const std::string &fmt, ...) {
             va_list ap;
             va_start(ap, fmt);
-            char *res;
-            int ret = vasprintf(&res, fmt.c_str(), ap);
-            if (ret == -1) {
-                std::cout << "vasprintf failed!!\n";
-                return;
-            }
-            va_end(ap); // 将 ap 指针置空
-            serialize(LogLevel::value::INFO, file, line, res);
-            free(res);
-        }
-        void warn(const std::string &file, size_t line, const std::string &fmt, ...) {
-            // 通过传入的参数构造出一个日志消息对象，进行日志的格式化，最终落地
-            // 1. 判断当前的日志是否达到了输出等级
-            if (LogLevel::value::WARN < _limit_level) { return ; }
-            // 2. 对 fmt 格式化字符串和不定参进行字符串组织，得到的日志消息的字符串
+            logv(LogLevel::value::INFO, file, line, fmt, ap);
+            va_end(ap);
+        }
+        void warn(const char *file, size_t line, const std::string &fmt, ...) {
             va_list ap;
             va_start(ap, fmt);
-            char *res;
-            int ret = vasprintf(&res, fmt.c_str(), ap);
-            if (ret == -1) {
-                std::cout << "vasprintf failed!!\n";
-                return;
-            }
-            va_end(ap); // 将 ap 指针置空
-            serialize(LogLevel::value::WARN, file, line, res);
-            free(res);
-
+            logv(LogLevel::value::WARN, file, line, fmt, ap);
+            va_end(ap);
         }
-        void error(const std::string &file, size_t line, const std::string &fmt, ...) {
-                        // 通过传入的参数构造出一个日志消息对象，进行日志的格式化，最终落地
-            // 1. 判断当前的日志是否达到了输出等级
-            if (LogLevel::value::ERROR < _limit_level) { return ; }
-            // 2. 对 fmt 格式化字符串和不定参进行字符串组织，得到的日志消息的字符串
+        void error(const char *file, size_t line, const std::string &fmt, ...) {
             va_list ap;
             va_start(ap, fmt);
-            char *res;
-            int ret = vasprintf(&res, fmt.c_str(), ap);
-            if (ret == -1) {
-                std::cout << "vasprintf failed!!\n";
-                return;
-            }
-            va_end(ap); // 将 ap 指针置空
-            serialize(LogLevel::value::ERROR, file, line, res);
-            free(res);
-        }
-        void fatal(const std::string &file, size_t line, const std::string &fmt, ...) {
-                        // 通过传入的参数构造出一个日志消息对象，进行日志的格式化，最终落地
-            // 1. 判断当前的日志是否达到了输出等级
-            if (LogLevel::value::FATAL < _limit_level) { return ; }
-            // 2. 对 fmt 格式化字符串和不定参进行字符串组织，得到的日志消息的字符串
+            logv(LogLevel::value::ERROR, file, line, fmt, ap);
+            va_end(ap);
+        }
+        void fatal(const char *file, size_t line, const std::string &fmt, ...) {
             va_list ap;
             va_start(ap, fmt);
-            char *res;
-            int ret = vasprintf(&res, fmt.c_str(), ap);
-            if (ret == -1) {
-                std::cout << "vasprintf failed!!\n";
-                return;
-            }
-            va_end(ap); // 将 ap 指针置空
-            serialize(LogLevel::value::FATAL, file, line, res);
-            free(res);
+            logv(LogLevel::value::FATAL, file, line, fmt, ap);
+            va_end(ap);
         }
-    protected:
-        void serialize(LogLevel::value level, const std::string &file, size_t line, char *str) {
-            // 3. 构造 LogMsg 对象
-            LogMsg msg(level, line, file, _logger_name, str);
-            // 4. 通过格式化工具 对 LogMsg 进行格式化，得到格式化后的日志字符串
-            std::stringstream ss;
-            _formatter->format(ss, msg);
-            // 5. 进行日志落地
-            log(ss.str().c_str(), ss.str().size());
+        // 结构化日志：logger->info("order placed", kv("id", id), kv("ms", latency))
+        // 消息不经过 printf 格式化，键值对由 %K / %J / %L 格式化子项输出；file 的要求同上
+        template<typename ...Fields>
+        void debug(const char *file, size_t line, const std::string &msg, const Field &field, const Fields &...fields) {
+            const Field arr[] = { field, fields... };
+            logs(LogLevel::value::DEBUG, file, line, msg, arr, sizeof...(fields) + 1);
         }
+        template<typename ...Fields>
+        void info(const char *file, size_t line, const std::string &msg, const Field &field, const Fields &...fields) {
+            const Field arr[] = { field, fields... };
+            logs(LogLevel::value::INFO, file, line, msg, arr, sizeof...(fields) + 1);
+        }
+        template<typename ...Fields>
+        void warn(const char *file, size_t line, const std::string &msg, const Field &field, const Fields &...fields) {
+            const Field arr[] = { field, fields... };
+            logs(LogLevel::value::WARN, file, line, msg, arr, sizeof...(fields) + 1);
+        }
+        template<typename ...Fields>
+        void error(const char *file, size_t line, const std::string &msg, const Field &field, const Fields &...fields) {
+            const Field arr[] = { field, fields... };
+            logs(LogLevel::value::ERROR, file, line, msg, arr, sizeof...(fields) + 1);
+        }
+        template<typename ...Fields>
+        void fatal(const char *file, size_t line, const std::string &msg, const Field &field, const Fields &...fields) {
+            const Field arr[] = { field, fields... };
+            logs(LogLevel::value::FATAL, file, line, msg, arr, sizeof...(fields) + 1);
+        }
+        // 运行时增加落地模块：按其格式与等级并入已有的组或新建一组，不停止日志器
+        bool addSink(const LogSink::ptr &sink);
+        // 运行时移除落地模块：此前写入的日志先全部落地，替换集合后等待仍在使用旧集合的写入者离开，
+        // 最后刷新被移除的落地模块；日志器不再持有其引用，没有其他持有者时随之析构
+        bool removeSink(const LogSink::ptr &sink);
+        // 被限流丢弃的日志数量
+        size_t dropped() const { return _limiter ? _limiter->dropped() : 0; }
+        // co_await logger->flush()：此前写入的日志全部落地后恢复；同步日志器刷新落地模块后立即就绪
+        virtual LogAwaitable flush(const Executor & /*executor*/ = Executor()) {
+            flushRepeat();
+            flushSinks();
+            return LogAwaitable();
+        }
+        // co_await logger->writable()：缓冲区低于水位线后恢复，用于 ASYNC_AWAIT 模式下的背压
+        virtual LogAwaitable writable(const Executor & /*executor*/ = Executor()) { return LogAwaitable(); }
+        // 补充输出折叠中尚未输出的重复次数：idle_ns 为 0 时立即输出，否则只在最后一次重复之后超过 idle_ns 纳秒时输出
+        void flushRepeat(uint64_t idle_ns = 0);
+        // 当前所有落地模块
+        std::vector<LogSink::ptr> sinkList();
+        // fork 前后由日志管理器调用（落地模块的锁由日志管理器统一获取，多个日志器共享的落地模块只加一次锁）
+        // 1. lockUpdate：停止替换落地模块集合；须先对所有日志器调用，否则其他日志器中等待读者离开的写者
+        //    可能正在等待一个阻塞在本日志器缓冲区上的读者
+        // 2. prepareFork：等待后台线程空闲，获取日志器内部的锁直到 fork 返回
+        // 3. afterFork：释放这些锁，子进程中重新启动后台线程
+        void lockUpdate() { _update_mutex.lock(); }
+        void unlockUpdate() { _update_mutex.unlock(); }
+        virtual void prepareFork() {
+            if (_limiter) _limiter->prepareFork();
+        }
+        virtual void afterFork(bool /*child*/) {
+            if (_limiter) _limiter->afterFork();
+        }
+    protected:
+        // 通过传入的参数构造出一个日志消息对象，进行日志的格式化，最终落地
+        void logv(LogLevel::value level, const char *file, size_t line, const std::string &fmt, va_list ap);
+        // 结构化日志：消息原样输出，不经过 printf 格式化
+        void logs(LogLevel::value level, const char *file, size_t line, const std::string &msg,
+            const Field *fields, size_t count);
+        void output(LogLevel::value level, const char *file, size_t line, RateLimiter::Site *site,
+            const char *payload, const Field *fields, size_t count);
+        // 在读端内调用
+        void outputRepeat(const RateLimiter::Repeat &rep);
+        virtual void serialize(LogLevel::value level, const char *file, size_t line, const char *str,
+            const Field *fields, size_t count);
+        virtual void serialize(const LogMsg &msg);
+        void flushSinks();
+        void syncSinks();
+        // 将此前写入的日志全部落地并持久化（fsync）后返回
+        virtual void persist() { syncSinks(); }
         // 抽象接口完成实际的落地输出 -- 不同的日志器有不同的实际落地方式
-        virtual void log(const char *data, size_t len) = 0;
+        virtual void log(const SinkGroup &group, const LogMsg &msg, const char *data, size_t len) = 0;
+        // 当前的落地模块集合，只能在读端内访问
+        const SinkSet &sinks() const { return *_sinkset.load(std::memory_order_acquire); }
+        // 新的集合发布之前由派生类检查与补充，返回 false 表示不接受
+        virtual bool prepare(SinkSet & /*set*/) { return true; }
+    private:
+        // 以新的落地模块列表生成集合并原子替换，旧集合在所有读者离开后释放
+        bool update(const std::vector<LogSink::ptr> &list);
     protected:
-        std::mutex _mutex;
         std::string _logger_name;
         std::atomic<LogLevel::value> _limit_level;
-        Formatter::ptr _formatter;
-        std::vector<LogSink::ptr> _sinks;
+        Formatter::ptr _formatter;          // 默认格式
+        std::atomic<SinkSet *> _sinkset;    // 按输出格式与等级分组的落地模块，增删落地模块时整体替换
+        std::atomic<LogLevel::value> _sink_level; // 所有落地模块中最低的输出等级
+        std::mutex _update_mutex;           // 串行化增删落地模块
+        RateLimiter::ptr _limiter; // 调用点限流器，为空表示不限流
+        Backtrace::ptr _backtrace; // 回溯缓冲，为空表示未开启回溯模式
+        bool _sync_fatal;          // FATAL 日志是否同步落地并持久化
     };
 
     class SyncLogger : public Logger {
@@ -145,16 +184,47 @@ namespace mylog {
         SyncLogger(const std::string &logger_name, 
             LogLevel::value level,
             Formatter::ptr &formatter,
-            std::vector<LogSink::ptr> &sinks):
-            Logger(logger_name, level, formatter, sinks) {}
+            std::vector<LogSink::ptr> &sinks,
+            const RateLimiter::ptr &limiter = RateLimiter::ptr(),
+            const Backtrace::ptr &backtrace = Backtrace::ptr(),
+            bool sync_fatal = false):
+            Logger(logger_name, level, formatter, sinks, limiter, backtrace, sync_fatal) {
+            prepare(*_sinkset.load());
+        }
+        ~SyncLogger() { flushRepeat(); }
     protected:
         // 同步日志器，是将日志直接通过落地模块句柄进行日志落地
-        void log(const char *data, size_t len) {
-            std::unique_lock<std::mutex> lock(_mutex);
-            if (_sinks.empty()) return;
-            for (auto &sink : _sinks) {
-                sink->log(data, len);
+        // 多个线程同时写入同一组落地模块时，由其中一个线程合并为一次落地
+        void log(const SinkGroup &group, const LogMsg &msg, const char *data, size_t len) {
+            LogBatch batch(&_logger_name);
+            batch.add(msg._ctime, msg._level);
+            LogRecord rec = { data, len, msg._level, msg._ns };
+            group._combiner->write(group, rec, batch);
+        }
+        // 为每组分配合并者，格式与等级不变的组沿用原来的合并者
+        bool prepare(SinkSet &set) override {
+            SinkSet *old = _sinkset.load();
+            for (auto &group : set._groups) {
+                for (auto &prev : old->_groups) {
+                    if (&prev != &group && prev._combiner && prev._level == group._level &&
+                        prev._formatter->pattern() == group._formatter->pattern()) {
+                        group._combiner = prev._combiner;
+                        break;
+                    }
+                }
+                if (!group._combiner) group._combiner = std::make_shared<Combiner>();
             }
+            return true;
+        }
+    public:
+        // 合并锁先于落地模块的锁获取，与合并者的加锁顺序一致
+        void prepareFork() override {
+            Logger::prepareFork();
+            for (auto &group : _sinkset.load()->_groups) group._combiner->prepareFork();
+        }
+        void afterFork(bool child) override {
+            for (auto &group : _sinkset.load()->_groups) group._combiner->afterFork(child);
+            Logger::afterFork(child);
         }
     };
 
@@ -164,22 +234,187 @@ namespace mylog {
             LogLevel::value level,
             Formatter::ptr &formatter,
             std::vector<LogSink::ptr> &sinks,
-            AsyncType looper_type):
-            Logger(logger_name, level, formatter, sinks),
-            _looper(std::make_shared<AsyncLooper>(std::bind(&AsyncLogger::realLog, this, std::placeholders::_1), looper_type)) {}
-        // 将数据写入缓冲区
-        void log(const char *data, size_t len) {
-            _looper->push(data, len);
+            AsyncType looper_type,
+            const RateLimiter::ptr &limiter = RateLimiter::ptr(),
+            const Backtrace::ptr &backtrace = Backtrace::ptr(),
+            size_t format_threads = 0,
+            size_t reorder_window = 0,
+            LogLevel::value urgent_level = LogLevel::value::OFF,
+            bool sync_fatal = false,
+            const std::string &spill_dir = "",
+            size_t spill_threshold = DEFAULT_BUFFER_SIZE,
+            const LooperPool::ptr &pool = LooperPool::ptr(),
+            size_t pool_weight = 1):
+            Logger(logger_name, level, formatter, sinks, limiter, backtrace, sync_fatal),
+            // 存在多种输出格式、需要按序号重排或有落地模块需要逐条的等级与时间戳时，缓冲区中必须保存未格式化的记录，因此自动切换为消费者格式化
+            _format_pool(format_threads > 0 || _sinkset.load()->_groups.size() > 1 || reorder_window > 0 ||
+                SinkGroup::hasRecords(_sinkset.load()->_groups) ?
+                std::make_shared<FormatPool>(format_threads) : FormatPool::ptr()),
+            _reorder(reorder_window > 0 ? std::make_shared<Reorder>(reorder_window) : Reorder::ptr()),
+            _order_seq(0),
+            _sync_target(0), _synced(0),
+            _looper(std::make_shared<AsyncLooper>(std::bind(&AsyncLogger::realLog, this,
+                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), looper_type,
+                std::bind(&AsyncLogger::onFlush, this), reorder_window, pool, pool_weight)) {
+            if (_format_pool) _looper->setFormat(FORMAT_RECORD);
+            _looper->setUrgentLevel(urgent_level);
+            // ASYNC_AWAIT 模式下 spill_threshold 为生产缓冲区的上限，spill_dir 为空时超过上限阻塞
+            if (looper_type == AsyncType::ASYNC_AWAIT) _looper->setLimit(spill_threshold);
+            if ((looper_type == AsyncType::ASYNC_SPILL || (looper_type == AsyncType::ASYNC_AWAIT && !spill_dir.empty())) &&
+                _looper->setSpill(spill_dir, spill_threshold) == false) {
+                std::cout << "溢出文件创建失败，缓冲区满时将阻塞等待：" << spill_dir << std::endl;
+            }
+        }
+        // 折叠中尚未输出的重复次数在工作线程退出之前写入缓冲区
+        ~AsyncLogger() { flushRepeat(); }
+        // 累计溢出到文件的字节数（ASYNC_SPILL 模式）
+        uint64_t spilled() const { return _looper->spilled(); }
+        LogAwaitable flush(const Executor &executor = Executor()) override {
+            flushRepeat();
+            return LogAwaitable(_looper, LogAwaitable::type::FLUSH, executor);
+        }
+        LogAwaitable writable(const Executor &executor = Executor()) override {
+            return LogAwaitable(_looper, LogAwaitable::type::WRITABLE, executor);
+        }
+    protected:
+        // 生产者格式化模式下缓冲区中是已按唯一一组的格式格式化、不再区分每条的日志，只适用于不超过一组且不需要逐条信息的集合
+        // 新的集合出现多组或需要逐条信息的落地模块时，切换为消费者格式化：
+        // 阻塞生产者，等待缓冲区中已格式化的日志全部落地后创建格式化线程池，之后缓冲区中只有紧凑记录
+        bool prepare(SinkSet &set) override {
+            if (_format_pool || (set._groups.size() <= 1 && SinkGroup::hasRecords(set._groups) == false)) return true;
+            FormatPool::ptr pool = std::make_shared<FormatPool>(0);
+            _looper->setFormat(FORMAT_RECORD, [&]() { _format_pool = pool; });
+            return true;
+        }
+    public:
+        // 将数据写入缓冲区（生产者格式化时只有一组落地模块）
+        // 格式化期间切换为消费者格式化时缓冲区拒绝写入，由 serialize 改为写入这条日志的记录
+        void log(const SinkGroup & /*group*/, const LogMsg &msg, const char *data, size_t len) {
+            if (_looper->push(data, len, msg._ctime, msg._level, FORMAT_TEXT, msg._route) == false) t_rejected() = true;
         } 
         // 设计一个实际落地函数（将缓冲区中的数据落地）
-        void realLog(Buffer &buf) {
-            if (_sinks.empty()) return;
-            for (auto &sink : _sinks) {
-                sink->log(buf.begin(), buf.readAbleSize());
+        void realLog(const char *data, size_t len, const LogBatch &summary) {
+            RcuReadGuard guard;
+            const SinkSet &set = sinks();
+            if (set._groups.empty()) return;
+            // 全局有序模式：记录先进入重排窗口，按序号输出
+            if (_reorder) {
+                _reorder->add(data, len);
+                return releaseRecords(false);
+            }
+            LogBatch batch = summary;
+            batch._logger = &_logger_name;
+            // 消费者格式化模式：缓冲区中是紧凑记录，每组格式化之后再落地
+            if (_format_pool) return formatRecords(data, len, batch);
+            for (auto &sink : set._groups[0]._sinks) {
+                std::unique_lock<std::mutex> lock(sink->mutex());
+                sink->logBatch(data, len, batch);
             }
         }
-
+        void formatRecords(const char *data, size_t len, const LogBatch &batch) {
+            if (len == 0) return;
+            RcuReadGuard guard;
+            _format_pool->format(data, len, sinks()._groups, _logger_name,
+                [&batch](const SinkGroup &group, const struct iovec *iov, size_t cnt, const LogRecord *recs, size_t nrec) {
+                    // 去掉该组落地模块不接收的等级
+                    LogBatch gbatch = batch;
+                    gbatch._levels &= ~((1u << (int)group._level) - 1);
+                    group.write(iov, cnt, recs, nrec, gbatch);
+                });
+        }
+        // 将重排窗口中可以输出的记录落地，force 为真时不再等待迟到的记录
+        void releaseRecords(bool force) {
+            LogBatch batch(&_logger_name);
+            _ordered.clear();
+            _reorder->take(_ordered, batch, force);
+            formatRecords(_ordered.data(), _ordered.size(), batch);
+        }
+        // 等待落地的调用者与工作线程退出前：输出重排窗口中的全部记录，再刷新落地模块
+        // 有 persist() 等待的日志已全部落地时，改为在消费线程中持久化，避免与落地并发操作落地模块
+        void onFlush() {
+            if (_reorder) releaseRecords(true);
+            uint64_t target = _sync_target.load();
+            if (target > _synced && _looper->flushed(target)) {
+                _synced = target;
+                syncSinks();
+                return;
+            }
+            flushSinks();
+        }
+        void persist() override {
+            uint64_t target = _looper->seq();
+            uint64_t cur = _sync_target.load();
+            while (cur < target && !_sync_target.compare_exchange_weak(cur, target)) {}
+            LogAwaitable(_looper, LogAwaitable::type::PERSIST).wait();
+        }
+        // 消费线程空闲后格式化线程也都空闲；子进程丢弃父进程尚未落地的日志与暂存的记录
+        void prepareFork() override {
+            Logger::prepareFork();
+            _looper->prepareFork();
+            if (_format_pool) _format_pool->prepareFork();
+        }
+        void afterFork(bool child) override {
+            if (child) {
+                if (_reorder) _reorder->restart(_order_seq.load());
+                _synced = _sync_target.load();
+            }
+            if (_format_pool) _format_pool->afterFork(child);
+            _looper->afterFork(child);
+            Logger::afterFork(child);
+        }
+    protected:
+        using Logger::serialize;
+        // 消费者格式化模式下，生产者只将紧凑记录拷贝进缓冲区，不进行格式化
+        void serialize(LogLevel::value level, const char *file, size_t line, const char *str,
+            const Field *fields, size_t count) override {
+            if (_looper->format() == FORMAT_TEXT) return Logger::serialize(level, file, line, str, fields, count);
+            ThreadContext &ctx = ThreadContext::local();
+            pushRecord(Clock::now(), level, level, line, std::this_thread::get_id(), file, strlen(file), str, strlen(str), fields, count,
+                ctx.data(), ctx.size());
+        }
+        void serialize(const LogMsg &msg) override {
+            if (_looper->format() == FORMAT_TEXT) {
+                // 格式化期间可能再次输出日志（如落地模块内部记录错误），保存外层的标志
+                bool outer = t_rejected();
+                t_rejected() = false;
+                Logger::serialize(msg);
+                bool rejected = t_rejected();
+                t_rejected() = outer;
+                if (rejected == false) return;
+            }
+            pushRecord(msg._ns, msg._level, msg._route, msg._line, msg._tid, msg._file, msg._file_len, msg._payload, msg._payload_len,
+                msg._fields, msg._field_count, msg._context, msg._context_len);
+        }
+        void pushRecord(int64_t ns, LogLevel::value level, LogLevel::value route, size_t line, std::thread::id tid,
+            const char *file, size_t flen, const char *payload, size_t plen, const Field *fields, size_t count,
+            const char *context, size_t clen) {
+            RecordHeader hdr;
+            hdr._seq = _reorder ? _order_seq.fetch_add(1, std::memory_order_relaxed) : 0;
+            hdr._ns = ns;
+            hdr._level = (uint8_t)level;
+            hdr._route = (uint8_t)route;
+            hdr._line = line;
+            hdr._tid = tid;
+            static thread_local std::string blob;
+            Record::encodeFields(fields, count, blob);
+            struct iovec iov[6];
+            size_t cnt = Record::encode(hdr, file, flen, payload, plen, blob, count, context, clen, iov);
+            _looper->push(iov, cnt, ns / NS_PER_SEC, level, FORMAT_RECORD, route);
+        }
+        // 本线程写入的已格式化日志被缓冲区拒绝
+        static bool &t_rejected() {
+            static thread_local bool rejected = false;
+            return rejected;
+        }
     private:
+        // 缓冲区中数据的形式：生产者格式化的文本，或由消费者格式化的紧凑记录
+        enum { FORMAT_TEXT = 0, FORMAT_RECORD = 1 };
+        FormatPool::ptr _format_pool; // 为空表示由生产者格式化（须在 _looper 之前声明，保证工作线程退出后才析构；运行中只在缓冲区为空时创建）
+        Reorder::ptr _reorder;        // 为空表示不重排，按写入缓冲区的顺序输出
+        std::atomic<uint64_t> _order_seq;
+        std::string _ordered;         // 消费线程按序号整理出的记录
+        std::atomic<uint64_t> _sync_target; // 需要持久化的日志数量
+        uint64_t _synced;                   // 已持久化的日志数量（仅消费线程访问）
         AsyncLooper::ptr _looper;
     };
 
@@ -195,22 +430,79 @@ namespace mylog {
     class LoggerBuilder {
     public:
         LoggerBuilder(): 
+            _looper_type(AsyncType::ASYNC_SAVE),
             _logger_type(LoggerType::LOGGER_SYNC),
             _limit_level(LogLevel::value::DEBUG),
-            _looper_type(AsyncType::ASYNC_SAVE) {}
+            _format_threads(0),
+            _reorder_window(0),
+            _urgent_level(LogLevel::value::OFF),
+            _sync_fatal(false),
+            _spill_threshold(DEFAULT_BUFFER_SIZE),
+            _pool_weight(1) {}
         void buildLoggerType(LoggerType type) { _logger_type = type; };
         void buildEnableUnSaveAsync() { _looper_type = AsyncType::ASYNC_UNSAVE; }
+        // 配合 co_await logger->writable() 在协程中实现背压：缓冲区超过水位线时协程让出，而不是阻塞线程
+        // 没有协程让出而继续写入、缓冲区超过 limit 字节时，指定了 spill_dir 则整批溢出到文件，否则与 ASYNC_SAVE 相同阻塞等待
+        void buildEnableAwaitAsync(size_t limit = AWAIT_MAX_SIZE, const std::string &spill_dir = "") {
+            _looper_type = AsyncType::ASYNC_AWAIT;
+            _spill_threshold = limit;
+            _spill_dir = spill_dir;
+        }
+        // 写入从不阻塞线程：缓冲区超过 threshold 字节后整批追加到目录 dir 下的溢出文件，落地恢复后按顺序重放
+        void buildEnableSpillAsync(const std::string &dir, size_t threshold = DEFAULT_BUFFER_SIZE) {
+            _looper_type = AsyncType::ASYNC_SPILL;
+            _spill_dir = dir;
+            _spill_threshold = threshold;
+        }
         void buildLoggerName(const std::string &name) { _logger_name = name; };
         void buildLoggerLevel(LogLevel::value level) { _limit_level = level; };
         void buildFormatter(const std::string &pattern) { 
             _formatter = std::make_shared<Formatter>(pattern);
         }
+        // 返回创建的落地模块，可继续设置其输出格式：builder->buildSink<FileSink>("./a.log")->setPattern("%m%n")
         template<typename SinkType, typename ...Args>
-        void buildSink(Args && ...args) {
-            LogSink::LogSink::ptr psink = SinkFactory::create<SinkType>(std::forward<Args>(args)...);
+        std::shared_ptr<SinkType> buildSink(Args && ...args) {
+            std::shared_ptr<SinkType> psink = std::make_shared<SinkType>(std::forward<Args>(args)...);
             _sinks.push_back(psink); 
+            return psink;
+        }
+        // 添加已创建的落地模块
+        void buildSink(const LogSink::ptr &sink) { _sinks.push_back(sink); }
+        // 设置所有调用点默认的限流策略
+        void buildLimitPolicy(const LimitPolicy &policy) {
+            limiter()->setDefaultPolicy(policy);
+        }
+        // 设置指定调用点（文件名 + 行号）的限流策略，优先于默认策略
+        void buildLimitPolicy(const std::string &file, size_t line, const LimitPolicy &policy) {
+            limiter()->setPolicy(file, line, policy);
+        }
+        // 开启回溯模式：[level, 日志器输出等级) 之间的日志在每个线程中保留最近 count 条，出错时一并输出
+        void buildBacktrace(size_t count, LogLevel::value level = LogLevel::value::DEBUG) {
+            _backtrace = std::make_shared<Backtrace>(count, level);
+        }
+        // 异步日志器由消费者完成格式化：生产者只拷贝紧凑记录，threads 为参与格式化的线程数量（包含消费线程）
+        void buildConsumerFormat(size_t threads = 1) { _format_threads = threads == 0 ? 1 : threads; }
+        // 异步日志器全局有序输出：每条日志获取序号，消费者在 window_ms 毫秒的重排窗口内按序号落地（自动切换为消费者格式化）
+        void buildOrdered(size_t window_ms = 10) { _reorder_window = window_ms == 0 ? 1 : window_ms; }
+        // 异步日志器的优先通道：达到 level 的日志绕过积压的普通日志，由消费线程优先落地
+        void buildPriorityLane(LogLevel::value level = LogLevel::value::ERROR) { _urgent_level = level; }
+        // FATAL 日志返回之前，将此前写入的所有日志落地并 fsync 到存储设备
+        void buildSyncFatal(bool on = true) { _sync_fatal = on; }
+        // 异步日志器不创建自己的工作线程，由多个日志器共享的线程池 pool 处理；weight 为轮转时每次最多处理的轮数
+        void buildSharedLooper(const LooperPool::ptr &pool, size_t weight = 1) {
+            _pool = pool;
+            _pool_weight = weight;
         }
         virtual Logger::ptr build() = 0; 
+    protected:
+        RateLimiter::ptr &limiter() {
+            if (_limiter.get() == nullptr) {
+                _limiter = std::make_shared<RateLimiter>();
+            }
+            return _limiter;
+        }
+        // 根据已设置的零部件构造日志器，局部与全局建造者共用
+        Logger::ptr create();
     protected:
         AsyncType _looper_type;
         LoggerType _logger_type;
@@ -218,66 +510,52 @@ namespace mylog {
         LogLevel::value _limit_level;
         Formatter::ptr _formatter;
         std::vector<LogSink::ptr> _sinks;
+        RateLimiter::ptr _limiter;
+        Backtrace::ptr _backtrace;
+        size_t _format_threads;
+        size_t _reorder_window;
+        LogLevel::value _urgent_level;
+        bool _sync_fatal;
+        std::string _spill_dir;
+        size_t _spill_threshold;
+        LooperPool::ptr _pool;
+        size_t _pool_weight;
     };
     // 2. 派生出具体的建造者类 --- 局部日志器的建造者 & 全局的日志器建造者（后边添加了全局单例管理器之后，将日志器添加全局管理）
     class LocalLoggerBuilder : public LoggerBuilder {
     public:
         Logger::ptr build() override {
-            assert(_logger_name.empty() == false); // 必须有日志器名称
-            if (_formatter.get() == nullptr) {
-                _formatter = std::make_shared<Formatter>();
-            }
-            if (_sinks.empty()) {
-                buildSink<StdoutSink>();
-            }
-            if (_logger_type == LoggerType::LOGGER_ASYNC) {
-                return std::make_shared<AsyncLogger>(_logger_name, _limit_level, _formatter, _sinks, _looper_type);
-            } 
-            return std::make_shared<SyncLogger>(_logger_name, _limit_level, _formatter, _sinks);
+            return create();
         }
     };
 
     class LoggerManager {
     public:
-        static LoggerManager& getInstance() {
-            // 在 C++11 之后，针对静态局部变量，编译器在编译的层面实现了线程安全
-            // 当静态局部变量在没有构造完成之前，其他的线程就会进入阻塞
-            static LoggerManager eton;
-            return eton;
-        }
-        void addLogger(Logger::ptr &logger) { // 增加日志器
-            if (hasLogger(logger->name())) return ;
-            std::unique_lock<std::mutex> lock(_mutex);
-            _loggers.insert(std::make_pair(logger->name(), logger));
-        }
-        bool hasLogger(const std::string &name) { // 判断是否存在日志器
-            std::unique_lock<std::mutex> lock(_mutex);
-            auto it = _loggers.find(name);
-            if (it == _loggers.end()) {
-                return false;
-            }
-            return true;
-        }
-        Logger::ptr getLogger(const std::string &name) { // 获取日志器
-                        std::unique_lock<std::mutex> lock(_mutex);
-            auto it = _loggers.find(name);
-            if (it == _loggers.end()) {
-                return Logger::ptr();
-            }
-            return it->second;
-        } 
+        static LoggerManager& getInstance();
+        void addLogger(Logger::ptr &logger); // 增加日志器
+        bool hasLogger(const std::string &name); // 判断是否存在日志器
+        Logger::ptr getLogger(const std::string &name); // 获取日志器
         Logger::ptr rootLogger() { // 获取默认日志器
             return _root_logger;
         }
     private:
-        LoggerManager() {
-            std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
-            builder->buildLoggerName("root");
-            _root_logger = builder->build();
-            _loggers.insert(std::make_pair("root", _root_logger));
+        LoggerManager();
+        // fork 时只有调用 fork 的线程被复制到子进程，其他线程持有的锁在子进程中永远不会释放
+        // 1. fork 之前：先获取折叠定时器的锁（其回调会获取日志器的锁），各日志器停止替换落地模块集合，等待后台线程空闲并获取内部的锁，再获取共享线程池与所有落地模块的锁并刷新其缓冲，
+        //    最后获取 RCU 读者列表的锁；此时没有其他线程处于日志库的临界区中
+        // 2. fork 之后：父进程释放这些锁；子进程还需清理父进程线程留下的状态、重新启动后台线程，
+        //    落地模块在子进程中重新建立与进程相关的资源（连接、共享内存等）
+        // 只有注册到日志管理器中的日志器（全局日志器与根日志器）受到保护
+        static void prepareFork();
+        static void parentAfterFork() { getInstance().afterFork(false); }
+        static void childAfterFork() {
+            ThreadContext::local().refreshTid();
+            getInstance().afterFork(true);
         }
+        void afterFork(bool child);
     private:
         std::mutex _mutex;
+        std::vector<LogSink::ptr> _fork_sinks; // fork 期间加锁的落地模块
         Logger::ptr _root_logger; // 默认日志器
         std::unordered_map<std::string, Logger::ptr> _loggers; // 用哈希表来增加查找速度
     };
@@ -286,23 +564,291 @@ namespace mylog {
     class GlobalLoggerBuilder : public LoggerBuilder {
     public:
         Logger::ptr build() override {
-            assert(_logger_name.empty() == false); // 必须有日志器名称
-            if (_formatter.get() == nullptr) {
-                _formatter = std::make_shared<Formatter>();
-            }
-            if (_sinks.empty()) {
-                buildSink<StdoutSink>();
-            }
-            Logger::ptr logger;
-            if (_logger_type == LoggerType::LOGGER_ASYNC) {
-                logger = std::make_shared<AsyncLogger>(_logger_name, _limit_level, _formatter, _sinks, _looper_type);
-            } else {
-                logger = std::make_shared<SyncLogger>(_logger_name, _limit_level, _formatter, _sinks);
-            }
+            Logger::ptr logger = create();
             LoggerManager::getInstance().addLogger(logger);
             return logger;
         }
     };
+
+    // 非模板成员的定义：默认在头文件中内联；定义 MYLOG_USE_LIBRARY 时只在 mylog.cc 中编译一次，由 libmylog 提供
+#if !defined(MYLOG_USE_LIBRARY) || defined(MYLOG_LIBRARY_SOURCE)
+    MYLOG_INLINE bool Logger::addSink(const LogSink::ptr &sink) {
+        std::unique_lock<std::mutex> lock(_update_mutex);
+        std::vector<LogSink::ptr> list = sinkList();
+        list.push_back(sink);
+        return update(list);
+    }
+
+    MYLOG_INLINE bool Logger::removeSink(const LogSink::ptr &sink) {
+        flush().wait();
+        std::unique_lock<std::mutex> lock(_update_mutex);
+        std::vector<LogSink::ptr> list = sinkList();
+        auto it = std::find(list.begin(), list.end(), sink);
+        if (it == list.end()) return false;
+        list.erase(it);
+        if (update(list) == false) return false;
+        std::unique_lock<std::mutex> slock(sink->mutex());
+        sink->flush();
+        return true;
+    }
+
+    MYLOG_INLINE void Logger::flushRepeat(uint64_t idle_ns) {
+        RateLimiter::Repeat rep;
+        if (!_limiter || !_limiter->hasDedup() || !_limiter->takeRepeat(rep, idle_ns)) return;
+        RcuReadGuard guard;
+        outputRepeat(rep);
+    }
+
+    MYLOG_INLINE std::vector<LogSink::ptr> Logger::sinkList() {
+        std::vector<LogSink::ptr> list;
+        for (auto &group : _sinkset.load()->_groups) list.insert(list.end(), group._sinks.begin(), group._sinks.end());
+        return list;
+    }
+
+    MYLOG_INLINE void Logger::logv(LogLevel::value level, const char *file, size_t line, const std::string &fmt, va_list ap) {
+        // 1. 判断当前的日志是否达到了输出等级（包括所有落地模块中最低的等级），未达到的日志在回溯模式下进入线程本地的环形缓冲
+        bool profile = Profiler::enabled();
+        if (level < _limit_level || level < _sink_level) {
+            if (profile) Profiler::instance().filtered(file, line, fmt);
+            if (_backtrace && level >= _backtrace->level()) {
+                _backtrace->capture(level, file, line, _logger_name, fmt, ap);
+            }
+            return ;
+        }
+        // 2. 调用点限流，在任何格式化之前进行判断
+        RateLimiter::Site *site = nullptr;
+        if (_limiter) {
+            site = _limiter->site(file, line);
+            if (_limiter->allow(site) == false) {
+                if (profile) Profiler::instance().filtered(file, line, fmt);
+                return ;
+            }
+        }
+        int64_t start = profile ? Clock::now() : 0;
+        // 3. 对 fmt 格式化字符串和不定参进行字符串组织，得到的日志消息的字符串
+        //    结果写入线程本地的缓冲区，避免每条日志一次内存分配
+        static thread_local std::string payload;
+        if (util::Str::vformat(payload, fmt.c_str(), ap) == false) {
+            std::cout << "vsnprintf failed!!\n";
+            return;
+        }
+        output(level, file, line, site, payload.c_str(), nullptr, 0);
+        // 4. 调用点统计：正文字节数与本次调用的耗时
+        if (profile) Profiler::instance().emitted(file, line, fmt, payload.size(), Clock::now() - start);
+    }
+
+    MYLOG_INLINE void Logger::logs(LogLevel::value level, const char *file, size_t line, const std::string &msg,
+        const Field *fields, size_t count) {
+        bool profile = Profiler::enabled();
+        if (level < _limit_level || level < _sink_level) {
+            if (profile) Profiler::instance().filtered(file, line, msg);
+            return ;
+        }
+        RateLimiter::Site *site = nullptr;
+        if (_limiter) {
+            site = _limiter->site(file, line);
+            if (_limiter->allow(site) == false) {
+                if (profile) Profiler::instance().filtered(file, line, msg);
+                return ;
+            }
+        }
+        int64_t start = profile ? Clock::now() : 0;
+        output(level, file, line, site, msg.c_str(), fields, count);
+        if (profile) {
+            size_t bytes = msg.size();
+            for (size_t i = 0; i < count; ++i)
+                bytes += fields[i]._key_len + (fields[i]._type == Field::type::STRING ? fields[i]._len : sizeof(Field::Value));
+            Profiler::instance().emitted(file, line, msg, bytes, Clock::now() - start);
+        }
+    }
+
+    MYLOG_INLINE void Logger::output(LogLevel::value level, const char *file, size_t line, RateLimiter::Site *site,
+        const char *payload, const Field *fields, size_t count) {
+        // 落地模块集合可能被并发替换，整个输出过程处于读端，使用的集合不会被释放
+        RcuReadGuard guard;
+        // 1. 折叠连续相同的日志，折叠结束时先补充输出上一条日志的重复次数
+        if (_limiter && _limiter->hasDedup()) {
+            RateLimiter::Repeat rep;
+            bool pass = _limiter->dedup(site, level, file, line, payload, rep);
+            if (rep._count > 0) outputRepeat(rep);
+            if (pass == false) return ;
+        }
+        // 2. 出错时先将当前线程回溯缓冲中的日志落地，再输出本条日志
+        //    缓冲的日志低于落地模块的等级，按本条日志的等级选择落地模块，与本条日志输出到相同的落地模块
+        if (_backtrace && level >= LogLevel::value::ERROR) {
+            _backtrace->dump([this, level](LogMsg &msg) {
+                msg._route = level;
+                serialize(msg);
+            });
+        }
+        serialize(level, file, line, payload, fields, count);
+        // 3. FATAL 日志返回之前，此前写入的所有日志都已落地并持久化到存储设备
+        if (_sync_fatal && level == LogLevel::value::FATAL) persist();
+    }
+
+    MYLOG_INLINE void Logger::outputRepeat(const RateLimiter::Repeat &rep) {
+        std::string tip = "last message repeated " + std::to_string(rep._count) + " times";
+        serialize(rep._level, rep._file.c_str(), rep._line, tip.c_str(), nullptr, 0);
+    }
+
+    MYLOG_INLINE void Logger::serialize(LogLevel::value level, const char *file, size_t line, const char *str,
+        const Field *fields, size_t count) {
+        // 构造 LogMsg 对象
+        LogMsg msg(level, line, file, _logger_name.c_str(), str, fields, count);
+        serialize(msg);
+    }
+
+    MYLOG_INLINE void Logger::serialize(const LogMsg &msg) {
+        // 通过格式化工具 对 LogMsg 进行格式化，得到格式化后的日志字符串
+        // 有效载荷只生成一次，每种格式只格式化一次，结果交给同组的所有落地模块
+        // 格式化写入线程私有的缓冲，缓冲跨调用复用；落地过程中再次输出日志（如落地模块内部记录错误）时改用临时缓冲
+        static thread_local LogStream t_out;
+        static thread_local bool t_busy = false;
+        LogStream tmp;
+        LogStream &out = t_busy ? tmp : t_out;
+        bool owner = !t_busy;
+        t_busy = true;
+        for (auto &group : sinks()._groups) {
+            if (msg._route < group._level) continue; // 未达到该组落地模块的输出等级，不进行格式化
+            out.reset();
+            group._formatter->format(out, msg);
+            // 进行日志落地
+            log(group, msg, out.data(), out.size());
+        }
+        if (owner) t_busy = false;
+    }
+
+    MYLOG_INLINE void Logger::flushSinks() {
+        RcuReadGuard guard;
+        for (auto &group : sinks()._groups) {
+            for (auto &sink : group._sinks) {
+                std::unique_lock<std::mutex> lock(sink->mutex());
+                sink->flush();
+            }
+        }
+    }
+
+    MYLOG_INLINE void Logger::syncSinks() {
+        RcuReadGuard guard;
+        for (auto &group : sinks()._groups) {
+            for (auto &sink : group._sinks) {
+                std::unique_lock<std::mutex> lock(sink->mutex());
+                sink->sync();
+            }
+        }
+    }
+
+    MYLOG_INLINE bool Logger::update(const std::vector<LogSink::ptr> &list) {
+        std::unique_ptr<SinkSet> set(new SinkSet(SinkGroup::group(_formatter, list)));
+        if (prepare(*set) == false) return false;
+        SinkSet *old = _sinkset.exchange(set.release());
+        _sink_level = _sinkset.load()->_sink_level;
+        Rcu::instance().synchronize();
+        delete old;
+        return true;
+    }
+
+    MYLOG_INLINE Logger::ptr LoggerBuilder::create() {
+        assert(_logger_name.empty() == false); // 必须有日志器名称
+        if (_formatter.get() == nullptr) {
+            _formatter = std::make_shared<Formatter>();
+        }
+        if (_sinks.empty()) {
+            buildSink<StdoutSink>();
+        }
+        Logger::ptr logger;
+        if (_logger_type == LoggerType::LOGGER_ASYNC) {
+            logger = std::make_shared<AsyncLogger>(_logger_name, _limit_level, _formatter, _sinks, _looper_type, _limiter, _backtrace, _format_threads, _reorder_window, _urgent_level, _sync_fatal, _spill_dir, _spill_threshold, _pool, _pool_weight);
+        } else {
+            logger = std::make_shared<SyncLogger>(_logger_name, _limit_level, _formatter, _sinks, _limiter, _backtrace, _sync_fatal);
+        }
+        // 折叠连续相同日志的日志器登记到定时器，长时间没有新的日志时补充输出重复次数（不延长日志器的生命周期）
+        if (_limiter && _limiter->hasDedup()) {
+            std::weak_ptr<Logger> weak(logger);
+            RepeatTimer::instance().add([weak]() {
+                Logger::ptr logger = weak.lock();
+                if (!logger) return false;
+                logger->flushRepeat(LIMITER_REPEAT_IDLE_MS * 1000000ull);
+                return true;
+            });
+        }
+        return logger;
+    }
+
+    MYLOG_INLINE LoggerManager& LoggerManager::getInstance() {
+        // 在 C++11 之后，针对静态局部变量，编译器在编译的层面实现了线程安全
+        // 当静态局部变量在没有构造完成之前，其他的线程就会进入阻塞
+        static LoggerManager eton;
+        return eton;
+    }
+
+    MYLOG_INLINE void LoggerManager::addLogger(Logger::ptr &logger) {
+        if (hasLogger(logger->name())) return ;
+        std::unique_lock<std::mutex> lock(_mutex);
+        _loggers.insert(std::make_pair(logger->name(), logger));
+    }
+
+    MYLOG_INLINE bool LoggerManager::hasLogger(const std::string &name) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _loggers.find(name);
+        if (it == _loggers.end()) {
+            return false;
+        }
+        return true;
+    }
+
+    MYLOG_INLINE Logger::ptr LoggerManager::getLogger(const std::string &name) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _loggers.find(name);
+        if (it == _loggers.end()) {
+            return Logger::ptr();
+        }
+        return it->second;
+    }
+
+    MYLOG_INLINE LoggerManager::LoggerManager() {
+        std::unique_ptr<mylog::LoggerBuilder> builder(new mylog::LocalLoggerBuilder());
+        builder->buildLoggerName("root");
+        _root_logger = builder->build();
+        _loggers.insert(std::make_pair("root", _root_logger));
+        pthread_atfork(&LoggerManager::prepareFork, &LoggerManager::parentAfterFork, &LoggerManager::childAfterFork);
+    }
+
+    MYLOG_INLINE void LoggerManager::prepareFork() {
+        LoggerManager &mgr = getInstance();
+        RepeatTimer::instance().prepareFork();
+        mgr._mutex.lock();
+        for (auto &it : mgr._loggers) it.second->lockUpdate();
+        for (auto &it : mgr._loggers) it.second->prepareFork();
+        LooperPool::prepareForkAll();
+        mgr._fork_sinks.clear();
+        for (auto &it : mgr._loggers) {
+            for (auto &sink : it.second->sinkList()) {
+                if (std::find(mgr._fork_sinks.begin(), mgr._fork_sinks.end(), sink) == mgr._fork_sinks.end())
+                    mgr._fork_sinks.push_back(sink);
+            }
+        }
+        for (auto &sink : mgr._fork_sinks) {
+            sink->mutex().lock();
+            sink->flush();
+        }
+        Rcu::instance().prepareFork();
+    }
+
+    MYLOG_INLINE void LoggerManager::afterFork(bool child) {
+        Rcu::instance().afterFork(child);
+        for (auto &sink : _fork_sinks) {
+            sink->afterFork(child);
+            sink->mutex().unlock();
+        }
+        _fork_sinks.clear();
+        LooperPool::afterForkAll(child);
+        for (auto &it : _loggers) it.second->afterFork(child);
+        for (auto &it : _loggers) it.second->unlockUpdate();
+        _mutex.unlock();
+        RepeatTimer::instance().afterFork(child);
+    }
+#endif
 }
 
 #endif /* __M_LOGGER_H__ */
@@ -8,72 +8,453 @@
 #include <functional>
 #include <memory>
 #include <atomic>
+#include <vector>
+#include <chrono>
+#include <algorithm>
 #include "buffer.hpp"
+#include "spill.hpp"
+#include "pool.hpp"
+#include "thread.hpp"
 
 namespace mylog {
-    using Functor = std::function<void(Buffer &)>;
+    #define URGENT_BUFFER_SIZE (64 * 1024)
+    #define URGENT_MAX_SIZE DEFAULT_BUFFER_SIZE // 优先通道生产缓冲区的上限（ASYNC_SAVE / ASYNC_SPILL）
+    #define POOL_BUFFER_SIZE (64 * 1024) // 线程池模式下缓冲区的初始大小，空闲后收缩回此大小
+    #define AWAIT_MAX_SIZE (4 * DEFAULT_BUFFER_SIZE) // ASYNC_AWAIT 模式下没有协程让出时生产缓冲区的默认上限
+    // 处理一段缓冲数据：起始地址、长度与其中日志的概要信息
+    using Functor = std::function<void(const char *, size_t, const LogBatch &)>;
     enum class AsyncType {
         ASYNC_SAVE,     // 安全状态，表示缓冲区满了则阻塞，避免资源耗尽的风险
-        ASYNC_UNSAVE    // 不考虑资源耗尽的问题，无限扩容，用于测试
+        ASYNC_UNSAVE,   // 不考虑资源耗尽的问题，无限扩容，用于测试
+        ASYNC_AWAIT,    // 缓冲区超过水位线后由协程 co_await writable() 让出，而不是阻塞线程；超过上限后溢出到文件或阻塞
+        ASYNC_SPILL     // 写入从不阻塞线程，缓冲区超过阈值后整批追加到溢出文件，落地恢复后按顺序重放
     };
-    class AsyncLooper {
+    // 在指定的执行器上运行回调，为空时直接在消费线程中运行
+    using Executor = std::function<void(const std::function<void()> &)>;
+    class AsyncLooper : public LooperPool::Task {
     public:
         using ptr = std::shared_ptr<AsyncLooper>;
-        AsyncLooper(const Functor &cb, AsyncType loop_type = AsyncType::ASYNC_SAVE): _stop(false), 
+        // on_flush 在有调用者等待落地时、恢复调用者之前运行，用于刷新落地模块自身的缓冲；工作线程退出前也会运行一次
+        // tick_ms 不为 0 时，即使没有新数据，消费线程也至少每 tick_ms 毫秒运行一次回调（缓冲区为空）
+        // pool 不为空时不创建工作线程，由共享的线程池处理（weight 为权重），缓冲区从 POOL_BUFFER_SIZE 开始按需增长
+        AsyncLooper(const Functor &cb, AsyncType loop_type = AsyncType::ASYNC_SAVE,
+            const std::function<void()> &on_flush = std::function<void()>(), size_t tick_ms = 0,
+            const LooperPool::ptr &pool = LooperPool::ptr(), size_t weight = 1):
+            _callBcak(cb),
+            _on_flush(on_flush),
             _looper_type(loop_type),
-            _thread(std::thread(&AsyncLooper::threadEntry, this)),
-            _callBcak(cb) {}
+            _tick_ms(tick_ms),
+            _stop(false),
+            _pro_buf(pool ? POOL_BUFFER_SIZE : DEFAULT_BUFFER_SIZE), _con_buf(pool ? POOL_BUFFER_SIZE : DEFAULT_BUFFER_SIZE),
+            _urgent_level(LogLevel::value::OFF),
+            _urg_pro(0), _urg_con(0),
+            _seq(0), _urg_count(0), _done(0), _format(0), _switching(false), _watermark(DEFAULT_BUFFER_SIZE), _spill_threshold(DEFAULT_BUFFER_SIZE),
+            _idle(pool != nullptr), _scheduled(false), _tick_due(false), _pool(pool) {
+            if (_pool) _pool->attach(this, weight, tick_ms);
+            else _thread.start(std::bind(&AsyncLooper::threadEntry, this));
+        }
         ~AsyncLooper() { stop(); }
         void stop() {
+            if (_pool) return stopShared();
             _stop = true; // 将退出标志设置为 true
             _cond_con.notify_all(); // 唤醒所有的工作线程
             _thread.join(); // 等待工作线程的退出
         }
-        void push(const char *data, size_t len) {
-            // 1. 无限扩容-非安全状态；    2. 固定大小--生产缓冲区中数据满了就阻塞
+        // ctime 与 level 为这条日志的时间与等级，用于生成批次概要信息（等级为 UNKNOW 时不记录）
+        // format 为数据的形式，与缓冲区当前的形式不一致时拒绝写入并返回 false（见 setFormat）
+        bool push(const char *data, size_t len, time_t ctime = 0, LogLevel::value level = LogLevel::value::UNKNOW,
+            int format = 0, LogLevel::value route = LogLevel::value::UNKNOW) {
+            struct iovec iov;
+            iov.iov_base = (void *)data;
+            iov.iov_len = len;
+            return push(&iov, 1, ctime, level, format, route);
+        }
+        // 开启优先通道：达到 level 的日志写入单独的小缓冲区，不因普通日志积压而阻塞
+        // 消费线程先处理优先通道，处理积压的普通日志时每个分片之前也会检查一次优先通道
+        // 优先通道的缓冲区在开启时才分配（另一个缓冲区在第一次交换后按需增长），未开启的日志器不占用内存；
+        // 优先通道积压超过 URGENT_MAX_SIZE 时同样按写入策略处理：ASYNC_SAVE 阻塞等待，ASYNC_SPILL 溢出到文件
+        void setUrgentLevel(LogLevel::value level) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _urgent_level = level;
+            if (level != LogLevel::value::OFF) _urg_pro.reserve(URGENT_BUFFER_SIZE);
+        }
+        // ASYNC_SPILL / ASYNC_AWAIT 模式：在目录 dir 中创建溢出文件，生产缓冲区超过 threshold 字节后整批溢出（须在写入之前调用）
+        // 溢出文件无法创建或写入失败（如磁盘已满）时，与 ASYNC_SAVE 相同，等待消费线程取走数据
+        bool setSpill(const std::string &dir, size_t threshold = DEFAULT_BUFFER_SIZE) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _spill_threshold = threshold;
+            return _spill.open(dir);
+        }
+        // ASYNC_AWAIT 模式：协程应在水位线处让出，没有协程让出而继续写入时生产缓冲区的上限（不低于水位线）；
+        // 超过上限后，设置了溢出文件时整批溢出，否则与 ASYNC_SAVE 相同阻塞等待（须在写入之前调用）
+        void setLimit(size_t limit) {
             std::unique_lock<std::mutex> lock(_mutex);
+            _spill_threshold = std::max(limit, _watermark);
+        }
+        // 累计溢出到文件的字节数
+        uint64_t spilled() const { return _spill.total(); }
+        // 缓冲区中数据的形式，由使用者定义（如已格式化的文本与未格式化的记录），默认为 0
+        int format() const { return _format.load(std::memory_order_acquire); }
+        // 切换数据的形式：阻塞生产者，等待此前写入的数据全部落地后运行 fn（如替换回调所用的状态），再切换形式；
+        // 之后按旧形式写入的数据被拒绝，由生产者按新的形式重新写入，缓冲区中不会混有两种形式的数据
+        void setFormat(int format, const std::function<void()> &fn = std::function<void()>()) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _switching = true;
+            wakeup();
+            _cond_idle.wait(lock, [&](){ return _done == _seq; });
+            if (fn) fn();
+            _format.store(format, std::memory_order_release);
+            _switching = false;
+            _cond_pro.notify_all();
+        }
+        // 将多个片段作为一个整体写入缓冲区，片段之间不会插入其他线程的数据
+        // route 高于 level 时按 route 选择通道（回溯输出的日志与触发输出的日志进入同一通道，保持先后顺序）
+        bool push(const struct iovec *iov, size_t cnt, time_t ctime = 0, LogLevel::value level = LogLevel::value::UNKNOW,
+            int format = 0, LogLevel::value route = LogLevel::value::UNKNOW) {
+            size_t len = Buffer::length(iov, cnt);
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_switching) _cond_pro.wait(lock, [&](){ return !_switching; });
+            if (format != _format.load(std::memory_order_relaxed)) return false;
+            if (std::max(level, route) >= _urgent_level) {
+                if (_looper_type == AsyncType::ASYNC_SAVE)
+                    _cond_pro.wait(lock, [&](){ return urgentRoom(len); });
+                else if (_looper_type != AsyncType::ASYNC_UNSAVE)
+                    spillUrgent(len, lock);
+                _urg_pro.push(iov, cnt);
+                ++_seq;
+                ++_urg_count;
+                _urg_pro.note(ctime, level);
+                wakeup();
+                return true;
+            }
+            // 1. 无限扩容-非安全状态；    2. 固定大小--生产缓冲区中数据满了就阻塞
+            // 3. 溢出与协程让出模式：超过上限后溢出到文件，无法溢出时阻塞
             // 条件变量空值，若缓冲区剩余空间大于数据长度，则可以添加数据
             if (_looper_type == AsyncType::ASYNC_SAVE)
-                _cond_pro.wait(lock, [&](){ return _pro_buf.writeAbleSize() >= len; });
+                _cond_pro.wait(lock, [&](){ return room(len); });
+            else if (_looper_type != AsyncType::ASYNC_UNSAVE)
+                spill(len, lock);
             // 能够走下来代表满足了条件，可以向缓冲区添加数据
-            _pro_buf.push(data, len);
+            _pro_buf.push(iov, cnt);
+            ++_seq;
+            if (level != LogLevel::value::UNKNOW) _pro_buf.note(ctime, level);
             // 唤醒消费者对缓冲区中的数据进行处理
-            _cond_con.notify_one();
+            wakeup();
+            return true;
+        }
+        // 前 target 条日志全部落地后运行回调；已经全部落地时不注册回调并返回 false
+        // always 为真时总是注册回调，由消费线程运行 on_flush 之后再回调
+        bool whenFlushed(uint64_t target, const std::function<void()> &cb, bool always = false) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_done >= target && !always) return false;
+            auto it = _flush_waiters.begin();
+            while (it != _flush_waiters.end() && it->_target <= target) ++it;
+            _flush_waiters.insert(it, Waiter{target, cb});
+            if (_done >= target) wakeup();
+            return true;
+        }
+        bool flushed(uint64_t target) { return _done >= target; }
+        uint64_t seq() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _seq;
+        }
+        // 生产缓冲区低于水位线后运行回调；当前已低于水位线时不注册回调并返回 false
+        bool whenWritable(const std::function<void()> &cb) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_pro_buf.readAbleSize() < _watermark) return false;
+            _space_waiters.push_back(cb);
+            return true;
+        }
+        bool writable() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _pro_buf.readAbleSize() < _watermark;
+        }
+        // fork 之前调用：等待消费线程处理完当前一轮并进入等待，之后一直持有 _mutex 直到 afterFork，生产者无法写入
+        void prepareFork() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond_idle.wait(lock, [&](){ return _idle; });
+            lock.release();
+        }
+        // fork 之后分别在父子进程中调用
+        // 子进程中消费线程已不存在：缓冲区中尚未落地的日志属于父进程（由父进程落地），直接丢弃，
+        // 等待者所在的线程也不存在了；条件变量重新初始化，丢弃父进程的线程句柄后启动新的消费线程
+        void afterFork(bool child) {
+            if (child) {
+                _pro_buf.reset();
+                _urg_pro.reset();
+                _urg_count = 0;
+                _spill.afterFork(child);
+                _flush_waiters.clear();
+                _space_waiters.clear();
+                _done = _seq;
+                _idle = _pool != nullptr;
+                _scheduled = false;
+                _tick_due = false;
+                _cond_pro.reinit();
+                _cond_con.reinit();
+                _cond_idle.reinit();
+                // 线程池由其自身重新启动
+                if (!_pool) {
+                    _thread.reset();
+                    _thread.start(std::bind(&AsyncLooper::threadEntry, this));
+                }
+            }
+            _mutex.unlock();
         }
     private:
+        struct Waiter {
+            uint64_t _target;
+            std::function<void()> _cb;
+        };
         // 线程入口函数--对消费缓冲区中的数据进行处理，处理完毕后，初始化缓冲区，交换缓冲区
         void threadEntry() {
+            std::unique_lock<std::mutex> lock(_mutex);
             while (1) {
                 // 1. 判断生产缓冲区中有没有数据，有则交换，无则阻塞
-                // 为互斥锁设置一个生命周期，缓冲区交换完毕之后就解锁（并不对数据的处理过程加锁保护）
-                {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    // 若当前是退出前被唤醒，或者有数据被唤醒，则返回真，继续向下运行，否则重新陷入休眠
-                    _cond_con.wait(lock, [&](){ return _stop || !_pro_buf.empty(); });
-                    // 退出标志被设置，且生产缓冲区已无数据，这时候再退出，否则有可能造成生产缓冲区中有数据，但是没有被完全处理
-                    if (_stop && _pro_buf.empty()) break;
-                    _con_buf.swap(_pro_buf);
-                    // 2. 唤醒生产者
-                    if (_looper_type == AsyncType::ASYNC_SAVE)
-                        _cond_pro.notify_all();
+                // 若当前是退出前被唤醒，或者有数据被唤醒，则返回真，继续向下运行，否则重新陷入休眠
+                auto pred = [&](){ return _stop || pending(); };
+                // 等待期间不持有任何锁，也不访问落地模块，可以安全地 fork
+                _idle = true;
+                _cond_idle.notify_all();
+                if (_tick_ms == 0) _cond_con.wait(lock, pred);
+                else _cond_con.wait_for(lock, std::chrono::milliseconds(_tick_ms), pred);
+                _idle = false;
+                // 退出标志被设置，且生产缓冲区已无数据，这时候再退出，否则有可能造成生产缓冲区中有数据，但是没有被完全处理
+                if (_stop && _pro_buf.empty() && _urg_pro.empty() && _spill.empty()) break;
+                consume(lock);
+            }
+            lock.unlock();
+            if (_on_flush) _on_flush();
+        }
+        // 线程池模式：由工作线程调用，处理期间 _idle 为假（fork 之前等待其为真）
+        bool run(size_t rounds) override {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _idle = false;
+            for (size_t i = 0; i < rounds && pending(); ++i) consume(lock);
+            bool again = pending();
+            if (!again) _scheduled = false;
+            _idle = true;
+            _cond_idle.notify_all();
+            return again;
+        }
+        // 线程池的定时检查：不能阻塞，锁被占用时留到下一次检查
+        void tick() override {
+            std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+            if (!lock.owns_lock() || _stop) return;
+            _tick_due = true;
+            wakeup();
+        }
+        // 线程池模式的停止：等待数据全部处理完毕、不再排队后离开线程池
+        void stopShared() {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+                _cond_idle.wait(lock, [&](){ return !_scheduled && _idle; });
+            }
+            _pool->detach(this);
+            if (_on_flush) _on_flush();
+        }
+        // 有需要处理的数据或到期的等待者（持有 _mutex 时调用）
+        bool pending() {
+            return !_pro_buf.empty() || !_urg_pro.empty() || !_spill.empty() || _tick_due ||
+                (!_flush_waiters.empty() && _flush_waiters.front()._target <= _done);
+        }
+        // 持有 _mutex 时调用：唤醒消费线程；线程池模式下尚未排队时排队
+        void wakeup() {
+            if (!_pool) return _cond_con.notify_one();
+            if (_scheduled) return;
+            _scheduled = true;
+            _pool->schedule(this);
+        }
+        // ASYNC_SAVE 模式下生产缓冲区能否写入 len 字节；线程池模式的缓冲区按需增长，积压以 DEFAULT_BUFFER_SIZE 为上限
+        bool room(size_t len) {
+            if (!_pool) return _pro_buf.writeAbleSize() >= len;
+            return _pro_buf.empty() || _pro_buf.readAbleSize() + len <= DEFAULT_BUFFER_SIZE;
+        }
+        // 处理一轮数据：取走生产缓冲区（或一批溢出数据）后解锁处理，最后恢复等待这批数据落地的调用者
+        // 进入与返回时都持有 lock（并不对数据的处理过程加锁保护）
+        void consume(std::unique_lock<std::mutex> &lock) {
+            uint64_t seq;
+            SpillFile::Chunk chunk;
+            std::vector<std::function<void()>> ready;
+            _tick_due = false;
+            _urg_con.swap(_urg_pro);
+            _urg_count = 0;
+            // 溢出文件中的数据早于生产缓冲区中的数据，全部重放之后才取走生产缓冲区
+            bool replay = !_spill.empty();
+            if (replay) {
+                chunk = _spill.pop();
+                seq = chunk._seq;
+            } else {
+                _con_buf.swap(_pro_buf);
+                seq = _seq;
+            }
+            // 2. 唤醒生产者（协程在锁外恢复）
+            if (_looper_type != AsyncType::ASYNC_UNSAVE) _cond_pro.notify_all();
+            ready.swap(_space_waiters);
+            lock.unlock();
+            for (auto &cb : ready) cb();
+            // 3. 先处理优先通道，再对消费缓冲区进行数据处理（定时唤醒时消费缓冲区可能为空）
+            consumeUrgent();
+            if (replay) {
+                // 读取失败的数据无法恢复，跳过
+                if (_spill.read(chunk, _replay)) _callBcak(_replay.data(), _replay.size(), chunk._batch);
+            } else if (_urgent_level == LogLevel::value::OFF || _con_buf.slices() <= 1) {
+                if (!_con_buf.empty() || _tick_ms > 0) _callBcak(_con_buf.begin(), _con_buf.readAbleSize(), _con_buf.batch());
+            } else {
+                for (size_t i = 0; i < _con_buf.slices(); ++i) {
+                    size_t len;
+                    const LogBatch *batch;
+                    const char *data = _con_buf.slice(i, len, batch);
+                    _callBcak(data, len, *batch);
+                    fetchUrgent();
+                    consumeUrgent();
                 }
-                // 3. 被唤醒后，对消费缓冲区进行数据处理
-                _callBcak(_con_buf);
-                // 4. 初始化消费缓冲区
-                _con_buf.reset();
             }
+            // 4. 初始化消费缓冲区；线程池模式下突发过后收缩，空闲日志器只占用少量内存
+            size_t consumed = _con_buf.readAbleSize();
+            _con_buf.reset();
+            if (_pool && consumed < POOL_BUFFER_SIZE) _con_buf.shrink(POOL_BUFFER_SIZE);
+            // 5. 恢复等待这批数据落地的调用者
+            ready.clear();
+            lock.lock();
+            _done = seq;
+            if (replay) _spill.truncate();
+            auto it = _flush_waiters.begin();
+            for (; it != _flush_waiters.end() && it->_target <= seq; ++it) ready.push_back(it->_cb);
+            _flush_waiters.erase(_flush_waiters.begin(), it);
+            lock.unlock();
+            if (!ready.empty() && _on_flush) _on_flush();
+            for (auto &cb : ready) cb();
+            lock.lock();
+        }
+        // 生产缓冲区加上本次写入超过阈值时，将缓冲区中已有的数据整批追加到溢出文件
+        void spill(size_t len, std::unique_lock<std::mutex> &lock) {
+            if (_pro_buf.empty() || _pro_buf.readAbleSize() + len <= _spill_threshold) return;
+            if (spillProducer()) return;
+            _cond_pro.wait(lock, [&](){ return _pro_buf.empty() || _pro_buf.readAbleSize() + len <= _spill_threshold; });
+        }
+        // 溢出块记录的落地数量不包含仍在优先通道中的日志（它们可能在之后的溢出块中才落地）
+        bool spillProducer() {
+            if (!_spill.isOpen()) return false;
+            if (_pro_buf.empty()) return true;
+            if (!_spill.append(_pro_buf.begin(), _pro_buf.readAbleSize(), _seq - _urg_count, _pro_buf.batch())) return false;
+            _pro_buf.reset();
+            return true;
+        }
+        bool urgentRoom(size_t len) {
+            return _urg_pro.empty() || _urg_pro.readAbleSize() + len <= URGENT_MAX_SIZE;
+        }
+        // 优先通道超过上限时：先将生产缓冲区整批溢出，再溢出优先通道，重放时各溢出块记录的落地数量依次递增
+        void spillUrgent(size_t len, std::unique_lock<std::mutex> &lock) {
+            if (urgentRoom(len)) return;
+            if (spillProducer() && _spill.append(_urg_pro.begin(), _urg_pro.readAbleSize(), _seq, _urg_pro.batch())) {
+                _urg_pro.reset();
+                _urg_count = 0;
+                return;
+            }
+            _cond_pro.wait(lock, [&](){ return urgentRoom(len); });
+        }
+        // 处理积压的普通日志期间取出新到达的优先日志（这些日志计入下一轮的落地数量），并唤醒等待优先通道空间的生产者
+        void fetchUrgent() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_urg_con.empty() || _urg_pro.empty()) return;
+            _urg_con.swap(_urg_pro);
+            _urg_count = 0;
+            if (_looper_type != AsyncType::ASYNC_UNSAVE) _cond_pro.notify_all();
+        }
+        void consumeUrgent() {
+            if (_urg_con.empty()) return;
+            _callBcak(_urg_con.begin(), _urg_con.readAbleSize(), _urg_con.batch());
+            _urg_con.reset();
         }
     private:
         Functor _callBcak; // 具体对缓冲区数据进行处理的回调函数，由异步工作器使用者传入
+        std::function<void()> _on_flush;
     private:
         AsyncType _looper_type;
+        size_t _tick_ms;
         std::atomic<bool> _stop;      // 工作器停止的标志
         Buffer _pro_buf; // 生产缓冲区
         Buffer _con_buf; // 消费缓冲区
+        std::atomic<LogLevel::value> _urgent_level; // 优先通道的最低等级，OFF 表示未开启
+        Buffer _urg_pro; // 优先通道的生产缓冲区
+        Buffer _urg_con; // 优先通道的消费缓冲区
         std::mutex _mutex;
-        std::condition_variable _cond_pro;
-        std::condition_variable _cond_con;
-        std::thread _thread; // 异步工作器对应的工作线程
+        Cond _cond_pro;
+        Cond _cond_con;
+        Cond _cond_idle;
+        uint64_t _seq;                   // 已写入的日志数量
+        uint64_t _urg_count;             // 优先通道生产缓冲区中的日志数量
+        std::atomic<uint64_t> _done;     // 已落地的日志数量
+        std::atomic<int> _format;        // 缓冲区中数据的形式
+        bool _switching;                 // 正在切换数据的形式，生产者等待
+        size_t _watermark;               // ASYNC_AWAIT 模式下生产缓冲区的水位线
+        size_t _spill_threshold;         // ASYNC_SPILL 模式下生产缓冲区的溢出阈值，ASYNC_AWAIT 模式下生产缓冲区的上限
+        SpillFile _spill;                // 溢出文件（追加与取出受 _mutex 保护，读取只由消费线程进行）
+        std::string _replay;             // 消费线程读取溢出数据的缓冲
+        std::vector<Waiter> _flush_waiters;              // 按目标数量递增排列
+        std::vector<std::function<void()>> _space_waiters;
+        bool _idle;                      // 消费线程正在等待新数据（线程池模式：没有工作线程正在处理）
+        bool _scheduled;                 // 线程池模式：已排队或正在被处理
+        bool _tick_due;                  // 线程池模式：定时检查到期，即使没有数据也运行一次回调
+        LooperPool::ptr _pool;           // 为空表示使用自己的工作线程
+        BackgroundThread _thread; // 异步工作器对应的工作线程
+    };
+
+    // 可等待对象：协程中 co_await logger->flush() / co_await logger->writable()，不阻塞线程
+    // 1. await_suspend 以模板接收协程句柄，本头文件不依赖 <coroutine>，仍可按 C++11 编译
+    // 2. 条件满足后由消费线程恢复协程，指定执行器时由执行器恢复（如投递回事件循环）
+    // 3. 非协程代码可调用 wait() 阻塞等待
+    class LogAwaitable {
+    public:
+        // PERSIST：与 FLUSH 相同，但总是经由消费线程运行一次 on_flush（用于持久化）
+        enum class type { FLUSH, WRITABLE, PERSIST };
+        LogAwaitable(const AsyncLooper::ptr &looper = AsyncLooper::ptr(), type t = type::FLUSH,
+            const Executor &executor = Executor()):
+            _looper(looper), _type(t), _target(0), _executor(executor) {
+            if (_looper && _type != type::WRITABLE) _target = _looper->seq();
+        }
+        bool await_ready() {
+            if (!_looper) return true;
+            if (_type == type::PERSIST) return false;
+            return _type == type::FLUSH ? _looper->flushed(_target) : _looper->writable();
+        }
+        template<typename Handle>
+        bool await_suspend(Handle handle) {
+            Executor executor = _executor;
+            std::function<void()> resume = [handle, executor]() {
+                Handle h = handle;
+                if (executor) executor([h]() { Handle r = h; r.resume(); });
+                else h.resume();
+            };
+            return when(resume);
+        }
+        void await_resume() {}
+        void wait() {
+            if (await_ready()) return;
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool done = false;
+            std::function<void()> cb = [&]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                done = true;
+                cond.notify_one();
+            };
+            if (when(cb) == false) return;
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return done; });
+        }
+    private:
+        bool when(const std::function<void()> &cb) {
+            if (_type == type::WRITABLE) return _looper->whenWritable(cb);
+            return _looper->whenFlushed(_target, cb, _type == type::PERSIST);
+        }
+    private:
+        AsyncLooper::ptr _looper;
+        type _type;
+        uint64_t _target;
+        Executor _executor;
     };
 } 
 
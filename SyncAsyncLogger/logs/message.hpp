@@ -10,36 +10,64 @@
     5. 线程ID          用于过滤出错的线程
     6. 日志主题消息
     7. 日志器名称    （当前支持多日志器的同时使用）
+    8. 结构化字段     （键值对，只在本次日志调用期间有效）
+    9. 线程上下文     （内核线程ID、线程名称与诊断上下文，指向线程本地或记录中的编码）
 */
 
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <thread>
 #include "level.hpp"
 #include "util.hpp"
+#include "field.hpp"
+#include "context.hpp"
+#include "clock.hpp"
 
 namespace mylog {
     struct LogMsg {
-        time_t _ctime; // 日志产生的时间戳
+        int64_t _ns;   // 日志产生的时间（自 1970 年起的纳秒数，由 Clock 获取）
+        time_t _ctime; // 日志产生的时间戳（秒）
         LogLevel::value _level; // 日志等级
+        LogLevel::value _route; // 按此等级选择落地模块：通常与 _level 相同，回溯输出的日志取触发输出的等级
         size_t _line; // 行号
         std::thread::id _tid; // 线程ID
-        std::string _file; // 源码文件名
-        std::string _logger; // 日志器名称       
-        std::string _payload; // 有效载荷
+        // 源码文件名、日志器名称与有效载荷只引用调用方的存储，不进行拷贝：
+        // 文件名为静态字符串，日志器名称随日志器存在，有效载荷为线程本地缓冲或记录中的数据，只在本次输出期间有效
+        const char *_file; // 源码文件名
+        size_t _file_len;
+        const char *_logger; // 日志器名称
+        size_t _logger_len;
+        const char *_payload; // 有效载荷
+        size_t _payload_len;
+        const Field *_fields; // 结构化字段
+        size_t _field_count;
+        const char *_context; // 线程上下文编码
+        size_t _context_len;
     
         LogMsg(LogLevel::value level,
             size_t line,
-            const std::string file,
-            const std::string logger,
-            const std::string msg):
-            _ctime(util::Date::now()),
+            const char *file,
+            const char *logger,
+            const char *msg,
+            const Field *fields = nullptr,
+            size_t field_count = 0):
+            _ns(Clock::now()),
+            _ctime(_ns / NS_PER_SEC),
             _level(level),
+            _route(level),
             _line(line),
             _tid(std::this_thread::get_id()),
             _file(file),
+            _file_len(strlen(file)),
             _logger(logger),
-            _payload(msg) {}
+            _logger_len(strlen(logger)),
+            _payload(msg),
+            _payload_len(strlen(msg)),
+            _fields(fields),
+            _field_count(field_count),
+            _context(ThreadContext::local().data()),
+            _context_len(ThreadContext::local().size()) {}
     };
 }
 
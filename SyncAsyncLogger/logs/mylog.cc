@@ -0,0 +1,14 @@
+/*
+    libmylog 的编译单元：提供日志器、日志管理器与落地模块的非模板成员的唯一定义，并集中实例化常用模板，
+    使用方定义 MYLOG_USE_LIBRARY 后直接链接这些定义与实例
+*/
+
+#define MYLOG_LIBRARY_SOURCE
+#ifndef MYLOG_USE_LIBRARY
+#define MYLOG_USE_LIBRARY
+#endif
+#include "mylog.h"
+
+namespace mylog {
+    MYLOG_INSTANTIATE()
+}
@@ -2,13 +2,45 @@
 #define __M_LOG_H__
 
 #include "logger.hpp"
+// MySQL 落地模块为可选模块：定义 MYLOG_WITH_MYSQL 并链接以 make MYSQL=1 编译的 libmylog 与 mysqlcppconn
+#ifdef MYLOG_WITH_MYSQL
+#include "mysql_sink.hpp"
+#endif
 
 namespace mylog {
+    // 常用模板的显式实例化（定义位于 mylog.cc），
+    // 链接 libmylog 的程序定义 MYLOG_USE_LIBRARY 后，各编译单元不再重复实例化这些模板
+    #define MYLOG_INSTANTIATE_LEVEL(ext, level) \
+        ext template void Logger::level<>(const char *, size_t, const std::string &, const Field &); \
+        ext template void Logger::level<Field>(const char *, size_t, const std::string &, const Field &, \
+            const Field &); \
+        ext template void Logger::level<Field, Field>(const char *, size_t, const std::string &, const Field &, \
+            const Field &, const Field &); \
+        ext template void Logger::level<Field, Field, Field>(const char *, size_t, const std::string &, \
+            const Field &, const Field &, const Field &, const Field &);
+    #define MYLOG_INSTANTIATE(ext) \
+        MYLOG_INSTANTIATE_LEVEL(ext, debug) \
+        MYLOG_INSTANTIATE_LEVEL(ext, info) \
+        MYLOG_INSTANTIATE_LEVEL(ext, warn) \
+        MYLOG_INSTANTIATE_LEVEL(ext, error) \
+        MYLOG_INSTANTIATE_LEVEL(ext, fatal) \
+        ext template Field kv<int>(const char *, int); \
+        ext template Field kv<long>(const char *, long); \
+        ext template Field kv<long long>(const char *, long long); \
+        ext template Field kv<unsigned>(const char *, unsigned); \
+        ext template Field kv<unsigned long>(const char *, unsigned long); \
+        ext template Field kv<unsigned long long>(const char *, unsigned long long); \
+        ext template Field kv<double>(const char *, double); \
+        ext template std::shared_ptr<StdoutSink> LoggerBuilder::buildSink<StdoutSink>();
+#ifdef MYLOG_USE_LIBRARY
+    MYLOG_INSTANTIATE(extern)
+#endif
+
     // 1. 提供获取指定日志器的全局接口（避免用户自己操作单例对象）
-    Logger::ptr getLogger(const std::string &name) {
+    inline Logger::ptr getLogger(const std::string &name) {
         return mylog::LoggerManager::getInstance().getLogger(name);
     }
-    Logger::ptr rootLogger() {
+    inline Logger::ptr rootLogger() {
         return mylog::LoggerManager::getInstance().rootLogger();
     }
     // 2. 使用宏函数对日志器的接口进行代理（代理模式）
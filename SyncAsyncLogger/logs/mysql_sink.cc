@@ -0,0 +1,203 @@
+/*
+    MySQL 落地模块的实现，只有这个编译单元依赖 MySQL Connector/C++ 的头文件
+*/
+
+#include <sstream>
+#include <iostream>
+#include <cassert>
+#include <ctime>
+#include <mysql_connection.h>
+#include <mysql_driver.h>
+#include <cppconn/driver.h>
+#include <cppconn/exception.h>
+#include <cppconn/resultset.h>
+#include <cppconn/statement.h>
+#include <cppconn/prepared_statement.h>
+#include "mysql_sink.hpp"
+
+namespace mylog {
+    MySQLSink::MySQLSink(const std::string &host, const std::string &user, const std::string &password, 
+              const std::string &database, int port) 
+        : _host(host), _user(user), _password(password), _database(database), _port(port) {
+        
+        try {
+            // 1. 获取MySQL驱动实例
+            _driver = sql::mysql::get_mysql_driver_instance();
+            
+            // 2. 创建数据库连接
+            std::stringstream connection_string;
+            connection_string << "tcp://" << _host << ":" << _port;
+            _connection.reset(_driver->connect(connection_string.str(), _user, _password));
+            
+            // 3. 选择数据库
+            _connection->setSchema(_database);
+            
+            // 4. 创建日志表（如果不存在）
+            createLogTable();
+            
+            // 5. 准备插入语句
+            prepareInsertStatement();
+            
+        } catch (sql::SQLException &e) {
+            std::cerr << "MySQL connection failed: " << e.what() << std::endl;
+            std::cerr << "Error code: " << e.getErrorCode() << std::endl;
+            std::cerr << "SQL state: " << e.getSQLState() << std::endl;
+            assert(false);
+        }
+    }
+
+    MySQLSink::~MySQLSink() {
+    }
+
+    void MySQLSink::log(const char *data, size_t len) {
+        if (!_connection || !_prep_stmt) {
+            return;
+        }
+        
+        try {
+            // 解析日志数据，提取各个字段
+            LogInfo log_info = parseLogData(data, len);
+            
+            // 绑定参数并执行插入
+            _prep_stmt->setString(1, log_info.timestamp);
+            _prep_stmt->setString(2, log_info.level);
+            _prep_stmt->setString(3, log_info.logger_name);
+            _prep_stmt->setString(4, log_info.file);
+            _prep_stmt->setInt(5, log_info.line);
+            _prep_stmt->setInt64(6, log_info.thread_id);
+            _prep_stmt->setString(7, log_info.message);
+            _prep_stmt->setString(8, std::string(data, len));
+            
+            _prep_stmt->executeUpdate();
+            
+        } catch (sql::SQLException &e) {
+            std::cerr << "Failed to insert log: " << e.what() << std::endl;
+            std::cerr << "Error code: " << e.getErrorCode() << std::endl;
+        }
+    }
+
+    void MySQLSink::createLogTable() {
+        try {
+            std::unique_ptr<sql::Statement> stmt(_connection->createStatement());
+            
+            const std::string sql = R"(
+                CREATE TABLE IF NOT EXISTS logs (
+                    id BIGINT AUTO_INCREMENT PRIMARY KEY,
+                    timestamp DATETIME NOT NULL,
+                    level VARCHAR(10) NOT NULL,
+                    logger_name VARCHAR(255) NOT NULL,
+                    file VARCHAR(500) NOT NULL,
+                    line INT NOT NULL,
+                    thread_id BIGINT NOT NULL,
+                    message TEXT NOT NULL,
+                    raw_log TEXT NOT NULL,
+                    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+                    INDEX idx_logs_timestamp (timestamp),
+                    INDEX idx_logs_level (level),
+                    INDEX idx_logs_logger_name (logger_name)
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )";
+            
+            stmt->execute(sql);
+            
+        } catch (sql::SQLException &e) {
+            std::cerr << "Failed to create table: " << e.what() << std::endl;
+            assert(false);
+        }
+    }
+
+    void MySQLSink::prepareInsertStatement() {
+        try {
+            const std::string sql = R"(
+                INSERT INTO logs (timestamp, level, logger_name, file, line, thread_id, message, raw_log)
+                VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+            )";
+            
+            _prep_stmt.reset(_connection->prepareStatement(sql));
+            
+        } catch (sql::SQLException &e) {
+            std::cerr << "Failed to prepare statement: " << e.what() << std::endl;
+            assert(false);
+        }
+    }
+
+    MySQLSink::LogInfo MySQLSink::parseLogData(const char *data, size_t len) {
+        LogInfo info;
+        std::string log_str(data, len);
+        
+        // 简单的日志解析，假设格式为: [timestamp][level][logger_name]file:line message
+        // 这里实现一个基本的解析器，实际使用中可能需要更复杂的解析逻辑
+        
+        // 默认值
+        info.timestamp = getCurrentTimestamp();
+        info.level = "INFO";
+        info.logger_name = "unknown";
+        info.file = "unknown";
+        info.line = 0;
+        info.thread_id = mylog::util::Thread::tid();
+        info.message = log_str;
+        
+        // 尝试解析格式化的日志
+        size_t pos = 0;
+        
+        // 解析时间戳 [timestamp]
+        if (log_str[pos] == '[') {
+            size_t end_pos = log_str.find(']', pos + 1);
+            if (end_pos != std::string::npos) {
+                info.timestamp = log_str.substr(pos + 1, end_pos - pos - 1);
+                pos = end_pos + 1;
+            }
+        }
+        
+        // 解析日志级别 [level]
+        if (pos < log_str.length() && log_str[pos] == '[') {
+            size_t end_pos = log_str.find(']', pos + 1);
+            if (end_pos != std::string::npos) {
+                info.level = log_str.substr(pos + 1, end_pos - pos - 1);
+                pos = end_pos + 1;
+            }
+        }
+        
+        // 解析日志器名称 [logger_name]
+        if (pos < log_str.length() && log_str[pos] == '[') {
+            size_t end_pos = log_str.find(']', pos + 1);
+            if (end_pos != std::string::npos) {
+                info.logger_name = log_str.substr(pos + 1, end_pos - pos - 1);
+                pos = end_pos + 1;
+            }
+        }
+        
+        // 解析文件名和行号 file:line
+        size_t colon_pos = log_str.find(':', pos);
+        size_t space_pos = log_str.find(' ', pos);
+        if (colon_pos != std::string::npos && space_pos != std::string::npos && colon_pos < space_pos) {
+            info.file = log_str.substr(pos, colon_pos - pos);
+            std::string line_str = log_str.substr(colon_pos + 1, space_pos - colon_pos - 1);
+            try {
+                info.line = std::stoi(line_str);
+            } catch (...) {
+                info.line = 0;
+            }
+            pos = space_pos + 1;
+        }
+        
+        // 剩余部分作为消息内容
+        if (pos < log_str.length()) {
+            info.message = log_str.substr(pos);
+            // 移除末尾的换行符
+            if (!info.message.empty() && info.message.back() == '\n') {
+                info.message.pop_back();
+            }
+        }
+        
+        return info;
+    }
+
+    std::string MySQLSink::getCurrentTimestamp() {
+        time_t now = time(nullptr);
+        struct tm *tm_info = localtime(&now);
+        char buffer[20];
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", tm_info);
+        return std::string(buffer);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef __M_MYSQL_SINK_H__
+#define __M_MYSQL_SINK_H__
+/*
+    可选的 MySQL 落地模块：实现位于 mysql_sink.cc，编译 libmylog 时以 make MYSQL=1 启用
+    本头文件不包含 MySQL Connector/C++ 的头文件，使用方只需链接 libmylog 与 mysqlcppconn
+*/
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "sink.hpp"
+
+namespace sql {
+    class Connection;
+    class PreparedStatement;
+    namespace mysql { class MySQL_Driver; }
+}
+
+namespace mylog {
+    // 落地方向：MySQL数据库
+    class MySQLSink : public LogSink {
+    public:
+        // 构造时传入数据库连接信息，创建数据库连接和日志表
+        MySQLSink(const std::string &host, const std::string &user, const std::string &password, 
+                  const std::string &database, int port = 3306);
+        ~MySQLSink();
+        // 将日志消息写入到MySQL数据库
+        void log(const char *data, size_t len);
+    private:
+        struct LogInfo {
+            std::string timestamp;
+            std::string level;
+            std::string logger_name;
+            std::string file;
+            int line;
+            int64_t thread_id;
+            std::string message;
+        };
+        void createLogTable();
+        void prepareInsertStatement();
+        LogInfo parseLogData(const char *data, size_t len);
+        std::string getCurrentTimestamp();
+    private:
+        std::string _host;
+        std::string _user;
+        std::string _password;
+        std::string _database;
+        int _port;
+        
+        sql::mysql::MySQL_Driver *_driver;
+        std::unique_ptr<sql::Connection> _connection;
+        std::unique_ptr<sql::PreparedStatement> _prep_stmt;
+    };
+}
+
+#endif /* __M_MYSQL_SINK_H__ */
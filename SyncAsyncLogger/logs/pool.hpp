@@ -0,0 +1,196 @@
+#ifndef __M_POOL_H__
+#define __M_POOL_H__
+/*
+    多个异步日志器共享的消费线程池：线程数量与日志器数量无关
+    1. 每个日志器的异步工作器作为一个任务，有数据时进入某个工作线程的队列，同一时刻最多由一个工作线程处理，日志器内部保持顺序
+    2. 工作线程先处理自己队列中的任务，队列为空时依次从其他线程的队列中取走任务（工作窃取）
+    3. 任务每次被取出后最多处理 weight 轮（每轮取走一次生产缓冲区），仍有数据时重新排到所在队列的末尾，
+       日志器之间轮转，权重大的日志器获得更多的处理机会
+    4. 有定时要求的任务（如重排窗口）由空闲或处理完一个任务的工作线程顺带检查
+*/
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include "thread.hpp"
+
+namespace mylog {
+    class LooperPool {
+    public:
+        using ptr = std::shared_ptr<LooperPool>;
+        // 由线程池调度的任务，调度状态（是否已排队）由任务自身维护，保证同一任务不会同时出现在多个队列中
+        class Task {
+        public:
+            Task(): _weight(1), _home(0), _tick_ms(0) {}
+            virtual ~Task() {}
+            // 最多处理 rounds 轮，返回真表示仍有数据需要处理（任务保持已排队状态，由线程池重新排队）
+            virtual bool run(size_t rounds) = 0;
+            // 定时检查，到期时任务自行排队；不能阻塞（持有线程池的锁调用）
+            virtual void tick() = 0;
+        public:
+            size_t _weight;
+            size_t _home;     // 排队时进入的队列（最近一次处理该任务的工作线程）
+            size_t _tick_ms;
+        };
+        LooperPool(size_t threads = 2): _stop(false), _pending(0), _sleeping(0), _next_tick(0), _min_tick_ms(0), _seed(0),
+            _queues(threads == 0 ? 1 : threads), _threads(_queues.size()) {
+            for (size_t i = 0; i < _threads.size(); ++i) _threads[i].start(std::bind(&LooperPool::threadEntry, this, i));
+            std::unique_lock<std::mutex> lock(registry());
+            pools().push_back(this);
+        }
+        ~LooperPool() {
+            {
+                std::unique_lock<std::mutex> lock(registry());
+                pools().erase(std::find(pools().begin(), pools().end(), this));
+            }
+            {
+                std::unique_lock<std::mutex> lock(_sleep_mutex);
+                _stop = true;
+                _cond.notify_all();
+            }
+            for (auto &thread : _threads) thread.join();
+        }
+        size_t threads() const { return _threads.size(); }
+        // 加入线程池：weight 为每次被取出后最多处理的轮数，tick_ms 不为 0 时至少每 tick_ms 毫秒检查一次
+        void attach(Task *task, size_t weight, size_t tick_ms) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            task->_weight = weight == 0 ? 1 : weight;
+            task->_home = _seed++ % _queues.size();
+            task->_tick_ms = tick_ms;
+            _tasks.push_back(task);
+            if (tick_ms > 0 && (_min_tick_ms == 0 || tick_ms < _min_tick_ms)) _min_tick_ms = tick_ms;
+        }
+        // 离开线程池，调用者保证任务已不在队列中且没有被处理
+        void detach(Task *task) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _tasks.erase(std::find(_tasks.begin(), _tasks.end(), task));
+            size_t min = 0;
+            for (Task *t : _tasks) if (t->_tick_ms > 0 && (min == 0 || t->_tick_ms < min)) min = t->_tick_ms;
+            _min_tick_ms = min;
+        }
+        // 将任务放入其所在的队列（任务此前未排队）
+        void schedule(Task *task) { enqueue(task->_home, task); }
+
+        // fork 时由日志管理器调用（此前各日志器的异步工作器已空闲并持有各自的锁）：获取所有线程池的锁
+        // 子进程中工作线程已不存在，清空队列后重新启动
+        static void prepareForkAll() {
+            registry().lock();
+            for (LooperPool *pool : pools()) pool->prepareFork();
+        }
+        static void afterForkAll(bool child) {
+            for (LooperPool *pool : pools()) pool->afterFork(child);
+            registry().unlock();
+        }
+    private:
+        struct Queue {
+            std::mutex _mutex;
+            std::deque<Task *> _tasks;
+        };
+        // 不析构：全局日志器持有的线程池可能在静态对象析构期间才析构，仍需注销
+        static std::mutex &registry() {
+            static std::mutex *mutex = new std::mutex();
+            return *mutex;
+        }
+        static std::vector<LooperPool *> &pools() {
+            static std::vector<LooperPool *> *list = new std::vector<LooperPool *>();
+            return *list;
+        }
+        void enqueue(size_t idx, Task *task) {
+            {
+                std::unique_lock<std::mutex> lock(_queues[idx]._mutex);
+                _queues[idx]._tasks.push_back(task);
+            }
+            _pending.fetch_add(1);
+            if (_sleeping.load() > 0) {
+                std::unique_lock<std::mutex> lock(_sleep_mutex);
+                _cond.notify_one();
+            }
+        }
+        // 先取自己队列的队首，再从其他队列的队首窃取（取等待最久的任务，保持轮转的公平）
+        Task *take(size_t idx) {
+            for (size_t k = 0; k < _queues.size(); ++k) {
+                Queue &queue = _queues[(idx + k) % _queues.size()];
+                std::unique_lock<std::mutex> lock(queue._mutex);
+                if (queue._tasks.empty()) continue;
+                Task *task = queue._tasks.front();
+                queue._tasks.pop_front();
+                _pending.fetch_sub(1);
+                return task;
+            }
+            return nullptr;
+        }
+        void threadEntry(size_t idx) {
+            while (1) {
+                Task *task = take(idx);
+                if (task) {
+                    task->_home = idx;
+                    if (task->run(task->_weight)) enqueue(idx, task);
+                    checkTicks();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(_sleep_mutex);
+                if (_stop) break;
+                ++_sleeping;
+                auto pred = [&]() { return _stop || _pending.load() > 0; };
+                size_t tick = _min_tick_ms.load(std::memory_order_relaxed);
+                if (tick == 0) _cond.wait(lock, pred);
+                else _cond.wait_for(lock, std::chrono::milliseconds(tick), pred);
+                --_sleeping;
+                lock.unlock();
+                checkTicks();
+            }
+        }
+        // 每个最短定时间隔内只由一个工作线程检查一次
+        void checkTicks() {
+            size_t tick = _min_tick_ms.load(std::memory_order_relaxed);
+            if (tick == 0) return;
+            int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            int64_t next = _next_tick.load(std::memory_order_relaxed);
+            if (now < next || _next_tick.compare_exchange_strong(next, now + tick) == false) return;
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (Task *task : _tasks) if (task->_tick_ms > 0) task->tick();
+        }
+        void prepareFork() {
+            _mutex.lock();
+            _sleep_mutex.lock();
+            for (auto &queue : _queues) queue._mutex.lock();
+        }
+        void afterFork(bool child) {
+            if (child) {
+                for (auto &queue : _queues) queue._tasks.clear();
+                _pending = 0;
+                _sleeping = 0;
+                _cond.reinit();
+                // 丢弃父进程中工作线程的句柄，启动新的工作线程
+                for (size_t i = 0; i < _threads.size(); ++i) {
+                    _threads[i].reset();
+                    _threads[i].start(std::bind(&LooperPool::threadEntry, this, i));
+                }
+            }
+            for (auto &queue : _queues) queue._mutex.unlock();
+            _sleep_mutex.unlock();
+            _mutex.unlock();
+        }
+    private:
+        bool _stop;                      // 受 _sleep_mutex 保护
+        std::atomic<size_t> _pending;    // 所有队列中的任务数量
+        std::atomic<size_t> _sleeping;   // 正在等待的工作线程数量
+        std::atomic<int64_t> _next_tick; // 下一次检查定时任务的时间（毫秒）
+        std::atomic<size_t> _min_tick_ms;
+        size_t _seed;                    // 新任务的初始队列，轮流分配
+        std::mutex _mutex;               // 保护任务列表，持有时可以尝试获取任务自身的锁
+        std::vector<Task *> _tasks;
+        std::mutex _sleep_mutex;
+        Cond _cond;
+        std::vector<Queue> _queues;
+        std::vector<BackgroundThread> _threads;
+    };
+}
+
+#endif /* __M_POOL_H__ */
@@ -0,0 +1,404 @@
+#ifndef __M_PROFILER_H__
+#define __M_PROFILER_H__
+/*
+    调用点日志量统计：找出产生大部分日志字节或占用大部分日志 CPU 的语句
+    1. 调用点以 文件名 + 行号 + 格式字符串 标识，统计输出条数、被过滤（等级不足或限流）条数、正文字节数与日志调用耗时
+    2. 每个线程有自己的计数表，只由所属线程写入，不增加日志路径上的竞争；汇总时读取所有线程的计数表，线程退出时并入汇总表
+       计数表从少量槽位开始，随调用点增多而扩容；以 __FILE__ 的地址与行号查找，不在日志路径上对字符串求哈希
+    3. report(n) 输出按字节数与按耗时排列的前 n 个调用点；installSignalDump 注册信号（默认 SIGUSR2），收到信号时由后台线程输出
+    4. 默认关闭，关闭时日志路径上只有一次原子读取
+*/
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "clock.hpp"
+#include "thread.hpp"
+
+namespace mylog {
+
+    #define PROFILER_SLOT_INIT 16       // 每个线程计数表的初始槽位数量
+    #define PROFILER_SLOT_COUNT 1024    // 每个线程计数表的最大槽位数量，超出后的调用点计入 "(other)"
+    #define PROFILER_FMT_MAX 120        // 报告中格式字符串的最大长度
+
+    // 一个调用点的汇总结果
+    struct CallsiteStat {
+        std::string _file;
+        size_t _line;
+        std::string _fmt;
+        uint64_t _count;     // 输出的条数
+        uint64_t _filtered;  // 等级不足或被限流丢弃的条数
+        uint64_t _bytes;     // 消息正文与结构化字段的字节数（格式化之后，不含时间、等级等公共部分）
+        uint64_t _ns;        // 日志调用的耗时：格式化、序列化以及同步日志器的落地
+        CallsiteStat(): _line(0), _count(0), _filtered(0), _bytes(0), _ns(0) {}
+    };
+
+    class Profiler {
+    public:
+        static Profiler &instance() {
+            static Profiler profiler;
+            return profiler;
+        }
+        // 日志器在每次日志调用时检查
+        static bool enabled() { return flag().load(std::memory_order_relaxed); }
+        void enable(bool on = true) { flag().store(on, std::memory_order_relaxed); }
+        // 调用点的哈希：__FILE__ 的地址、行号与格式字符串的长度（格式字符串多为临时对象，地址不固定），0 保留为空槽位标记
+        // 哈希相同时再比较文件地址、行号与格式字符串的内容
+        static uint64_t key(const char *file, size_t line, const std::string &fmt) {
+            uint64_t k = ((uint64_t)(uintptr_t)file * 31 + line) * 1000003 ^ fmt.size();
+            k ^= k >> 29;
+            return k == 0 ? 1 : k;
+        }
+        // 以下两个接口只在 enabled() 时由日志器调用，file 须为静态存储的字符串（如 __FILE__）
+        void filtered(const char *file, size_t line, const std::string &fmt) {
+            Slot *slot = local()->find(key(file, line, fmt), file, line, fmt);
+            bump(slot->_filtered, 1);
+        }
+        void emitted(const char *file, size_t line, const std::string &fmt, size_t bytes, int64_t ns) {
+            Slot *slot = local()->find(key(file, line, fmt), file, line, fmt);
+            bump(slot->_count, 1);
+            bump(slot->_bytes, bytes);
+            bump(slot->_ns, ns > 0 ? ns : 0);
+        }
+        // 汇总所有线程的计数（包括已退出的线程）
+        // 按文件名、行号与格式字符串合并：头文件中的同一调用点在不同编译单元中的 __FILE__ 地址不同
+        std::vector<CallsiteStat> snapshot() {
+            std::unordered_map<std::string, CallsiteStat> all;
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (Table *table : _tables) table->collect(all);
+            _retired.collect(all);
+            std::vector<CallsiteStat> list;
+            list.reserve(all.size());
+            for (auto &it : all) list.push_back(it.second);
+            return list;
+        }
+        // 清零所有计数；与并发写入之间不加锁，清零期间的少量计数可能保留
+        void reset() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (Table *table : _tables) table->clear();
+            _retired.clear();
+        }
+        // 文本报告：总量，以及按字节数、按耗时排列的前 top 个调用点
+        std::string report(size_t top = 20) {
+            std::vector<CallsiteStat> list = snapshot();
+            CallsiteStat total;
+            for (auto &stat : list) {
+                total._count += stat._count;
+                total._filtered += stat._filtered;
+                total._bytes += stat._bytes;
+                total._ns += stat._ns;
+            }
+            char line[512];
+            std::string out;
+            snprintf(line, sizeof(line), "callsite profile: %zu callsites, %llu messages, %llu filtered, %llu bytes, %.3f ms\n",
+                list.size(), (unsigned long long)total._count, (unsigned long long)total._filtered,
+                (unsigned long long)total._bytes, total._ns / 1e6);
+            out += line;
+            section(out, "bytes", list, total, top, [](const CallsiteStat &a, const CallsiteStat &b) { return a._bytes > b._bytes; });
+            section(out, "cpu", list, total, top, [](const CallsiteStat &a, const CallsiteStat &b) { return a._ns > b._ns; });
+            return out;
+        }
+        // 收到信号 signo 时输出报告：追加到文件 path，为空时输出到标准错误
+        // 信号处理函数只向管道写入一个字节，报告由后台线程生成
+        bool installSignalDump(int signo = SIGUSR2, const std::string &path = "", size_t top = 20) {
+            std::unique_lock<std::mutex> lock(_dump_mutex);
+            _dump_path = path;
+            _dump_top = top;
+            if (_dump_fd[0] < 0 && startDumper() == false) return false;
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = &Profiler::onSignal;
+            sa.sa_flags = SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            return sigaction(signo, &sa, nullptr) == 0;
+        }
+        // 立即输出一次报告（与收到信号时相同）
+        void dump() {
+            std::string path;
+            size_t top;
+            {
+                std::unique_lock<std::mutex> lock(_dump_mutex);
+                path = _dump_path;
+                top = _dump_top;
+            }
+            std::string text = report(top);
+            int fd = path.empty() ? STDERR_FILENO : ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+            if (fd < 0) return;
+            size_t done = 0;
+            while (done < text.size()) {
+                ssize_t ret = ::write(fd, text.data() + done, text.size() - done);
+                if (ret < 0 && errno == EINTR) continue;
+                if (ret <= 0) break;
+                done += ret;
+            }
+            if (fd != STDERR_FILENO) ::close(fd);
+        }
+    private:
+        // 计数只由所属线程写入（读取后写回，不需要原子的读改写），汇总线程读取
+        struct Slot {
+            std::atomic<uint64_t> _key;
+            const char *_where;  // __FILE__ 的地址，用于比较
+            std::string _file;
+            size_t _line;
+            std::string _fmt;    // 完整的格式字符串，用于比较；报告中截断为 PROFILER_FMT_MAX
+            std::atomic<uint64_t> _count;
+            std::atomic<uint64_t> _filtered;
+            std::atomic<uint64_t> _bytes;
+            std::atomic<uint64_t> _ns;
+            Slot(): _key(0), _where(nullptr), _line(0), _count(0), _filtered(0), _bytes(0), _ns(0) {}
+            bool match(uint64_t k, const char *file, size_t line, const std::string &fmt) const {
+                return _key.load(std::memory_order_relaxed) == k && _where == file && _line == line && _fmt == fmt;
+            }
+            // 扩容时复制（由所属线程进行，之后才发布新的槽位数组；汇总线程可能仍在读取原槽位，不能搬移）
+            void assign(const Slot &src) {
+                _where = src._where;
+                _file = src._file;
+                _line = src._line;
+                _fmt = src._fmt;
+                _count.store(src._count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                _filtered.store(src._filtered.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                _bytes.store(src._bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                _ns.store(src._ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                _key.store(src._key.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        };
+        struct Table {
+            std::unique_ptr<Slot[]> _slots;
+            size_t _cap;   // 槽位数量，2 的幂
+            size_t _used;
+            Slot _other;   // 槽位耗尽后的调用点
+            std::mutex *_guard; // 替换槽位数组时持有（汇总线程持有它读取），为空表示调用者已持有
+            Table(std::mutex *guard): _slots(new Slot[PROFILER_SLOT_INIT]), _cap(PROFILER_SLOT_INIT), _used(0), _guard(guard) {
+                _other._file = "(other)";
+                _other._key = 1;
+            }
+            // 线性探测；首次出现时由所属线程填写名称，再发布键；超过一半的槽位被占用时扩容
+            Slot *find(uint64_t k, const char *file, size_t line, const std::string &fmt) {
+                for (size_t i = 0; i < _cap; ++i) {
+                    Slot &slot = _slots[(k + i) & (_cap - 1)];
+                    uint64_t cur = slot._key.load(std::memory_order_relaxed);
+                    if (cur == 0) return insert(slot, k, file, line, fmt);
+                    if (slot.match(k, file, line, fmt)) return &slot;
+                }
+                return &_other;
+            }
+            Slot *insert(Slot &slot, uint64_t k, const char *file, size_t line, const std::string &fmt) {
+                if ((_used + 1) * 2 > _cap && _cap < PROFILER_SLOT_COUNT) {
+                    grow();
+                    return find(k, file, line, fmt);
+                }
+                slot._where = file;
+                slot._file = file;
+                slot._line = line;
+                slot._fmt = fmt;
+                ++_used;
+                slot._key.store(k, std::memory_order_release);
+                return &slot;
+            }
+            // 在新数组中重新放置已有的调用点，再在锁内替换，汇总线程不会读到正在搬移的数组
+            void grow() {
+                size_t cap = _cap * 2;
+                std::unique_ptr<Slot[]> slots(new Slot[cap]);
+                for (size_t i = 0; i < _cap; ++i) {
+                    uint64_t k = _slots[i]._key.load(std::memory_order_relaxed);
+                    if (k == 0) continue;
+                    size_t j = k & (cap - 1);
+                    while (slots[j]._key.load(std::memory_order_relaxed) != 0) j = (j + 1) & (cap - 1);
+                    slots[j].assign(_slots[i]);
+                }
+                std::unique_lock<std::mutex> lock;
+                if (_guard) lock = std::unique_lock<std::mutex>(*_guard);
+                _slots.swap(slots);
+                _cap = cap;
+            }
+            void collect(std::unordered_map<std::string, CallsiteStat> &all) {
+                for (size_t i = 0; i < _cap; ++i) add(_slots[i], all);
+                add(_other, all);
+            }
+            void add(Slot &slot, std::unordered_map<std::string, CallsiteStat> &all) {
+                uint64_t k = slot._key.load(std::memory_order_acquire);
+                if (k == 0) return;
+                uint64_t count = slot._count.load(std::memory_order_relaxed);
+                uint64_t filtered = slot._filtered.load(std::memory_order_relaxed);
+                if (count == 0 && filtered == 0) return;
+                std::string name = slot._file + '\0' + std::to_string(slot._line) + '\0' + slot._fmt;
+                CallsiteStat &stat = all[name];
+                if (stat._file.empty()) {
+                    stat._file = slot._file;
+                    stat._line = slot._line;
+                    stat._fmt = slot._fmt.substr(0, PROFILER_FMT_MAX);
+                }
+                stat._count += count;
+                stat._filtered += filtered;
+                stat._bytes += slot._bytes.load(std::memory_order_relaxed);
+                stat._ns += slot._ns.load(std::memory_order_relaxed);
+            }
+            // 将另一个计数表并入（持有 _mutex 时调用）
+            void merge(Table &table) {
+                for (size_t i = 0; i <= table._cap; ++i) {
+                    Slot &src = i < table._cap ? table._slots[i] : table._other;
+                    uint64_t k = src._key.load(std::memory_order_acquire);
+                    if (k == 0) continue;
+                    Slot *dst = &src == &table._other ? &_other : find(k, src._where, src._line, src._fmt);
+                    bump(dst->_count, src._count.load(std::memory_order_relaxed));
+                    bump(dst->_filtered, src._filtered.load(std::memory_order_relaxed));
+                    bump(dst->_bytes, src._bytes.load(std::memory_order_relaxed));
+                    bump(dst->_ns, src._ns.load(std::memory_order_relaxed));
+                }
+            }
+            void clear() {
+                for (size_t i = 0; i <= _cap; ++i) {
+                    Slot &slot = i < _cap ? _slots[i] : _other;
+                    slot._count.store(0, std::memory_order_relaxed);
+                    slot._filtered.store(0, std::memory_order_relaxed);
+                    slot._bytes.store(0, std::memory_order_relaxed);
+                    slot._ns.store(0, std::memory_order_relaxed);
+                }
+            }
+        };
+        // 线程退出时将计数并入汇总表
+        struct Holder {
+            Table *_table;
+            Holder(): _table(nullptr) {}
+            ~Holder() { if (_table) Profiler::instance().retire(_table); }
+        };
+
+        Profiler(): _retired(nullptr), _dump_top(20) {
+            _dump_fd[0] = _dump_fd[1] = -1;
+            pthread_atfork(&Profiler::prepareFork, &Profiler::parentAfterFork, &Profiler::childAfterFork);
+        }
+        ~Profiler() { stopDumper(); }
+        static std::atomic<bool> &flag() {
+            static std::atomic<bool> on(false);
+            return on;
+        }
+        static std::atomic<int> &signalFd() {
+            static std::atomic<int> fd(-1);
+            return fd;
+        }
+        static void bump(std::atomic<uint64_t> &counter, uint64_t n) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        Table *local() {
+            static thread_local Holder holder;
+            if (holder._table == nullptr) {
+                holder._table = new Table(&_mutex);
+                std::unique_lock<std::mutex> lock(_mutex);
+                _tables.push_back(holder._table);
+            }
+            return holder._table;
+        }
+        void retire(Table *table) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _retired.merge(*table);
+            _tables.erase(std::find(_tables.begin(), _tables.end(), table));
+            delete table;
+        }
+        template<typename Less>
+        static void section(std::string &out, const char *name, std::vector<CallsiteStat> &list, const CallsiteStat &total,
+            size_t top, Less less) {
+            char line[512];
+            size_t n = std::min(top, list.size());
+            std::partial_sort(list.begin(), list.begin() + n, list.end(), less);
+            snprintf(line, sizeof(line), "top %zu by %s:\n  %14s %6s %12s %10s %10s %8s  %s\n", n, name,
+                "bytes", "share", "messages", "filtered", "cpu_ms", "avg_ns", "callsite");
+            out += line;
+            for (size_t i = 0; i < n; ++i) {
+                const CallsiteStat &stat = list[i];
+                uint64_t sum = name[0] == 'b' ? total._bytes : total._ns;
+                uint64_t val = name[0] == 'b' ? stat._bytes : stat._ns;
+                snprintf(line, sizeof(line), "  %14llu %5.1f%% %12llu %10llu %10.3f %8llu  %s:%zu \"%s\"\n",
+                    (unsigned long long)stat._bytes, sum ? val * 100.0 / sum : 0.0, (unsigned long long)stat._count,
+                    (unsigned long long)stat._filtered, stat._ns / 1e6,
+                    (unsigned long long)(stat._count ? stat._ns / stat._count : 0),
+                    stat._file.c_str(), stat._line, stat._fmt.c_str());
+                out += line;
+            }
+        }
+        static void onSignal(int) {
+            int saved = errno;
+            int fd = signalFd().load(std::memory_order_relaxed);
+            if (fd >= 0) {
+                char c = 1;
+                ssize_t ret = ::write(fd, &c, 1);
+                (void)ret;
+            }
+            errno = saved;
+        }
+        // 持有 _dump_mutex 时调用
+        bool startDumper() {
+            if (pipe(_dump_fd) != 0) return false;
+            fcntl(_dump_fd[0], F_SETFD, FD_CLOEXEC);
+            fcntl(_dump_fd[1], F_SETFD, FD_CLOEXEC);
+            fcntl(_dump_fd[1], F_SETFL, O_NONBLOCK); // 管道已满时丢弃多余的信号
+            signalFd().store(_dump_fd[1]);
+            _dumper.start(std::bind(&Profiler::dumperEntry, this, _dump_fd[0]));
+            return true;
+        }
+        void stopDumper() {
+            if (_dump_fd[1] < 0) return;
+            signalFd().store(-1);
+            ::close(_dump_fd[1]); // 读端读到文件结束后后台线程退出
+            _dumper.join();
+            ::close(_dump_fd[0]);
+            _dump_fd[0] = _dump_fd[1] = -1;
+        }
+        void dumperEntry(int fd) {
+            char buf[64];
+            while (1) {
+                ssize_t ret = ::read(fd, buf, sizeof(buf));
+                if (ret < 0 && errno == EINTR) continue;
+                if (ret <= 0) break;
+                dump();
+            }
+        }
+        // fork 时持有计数表列表的锁；子进程中后台线程已不存在，以新的管道重新启动
+        static void prepareFork() {
+            instance()._dump_mutex.lock();
+            instance()._mutex.lock();
+        }
+        static void parentAfterFork() {
+            instance()._mutex.unlock();
+            instance()._dump_mutex.unlock();
+        }
+        static void childAfterFork() {
+            Profiler &profiler = instance();
+            profiler._mutex.unlock();
+            if (profiler._dump_fd[0] >= 0) {
+                ::close(profiler._dump_fd[0]);
+                ::close(profiler._dump_fd[1]);
+                profiler._dump_fd[0] = profiler._dump_fd[1] = -1;
+                signalFd().store(-1);
+                // 句柄对应父进程中的后台线程，丢弃后重新启动
+                profiler._dumper.reset();
+                profiler.startDumper();
+            }
+            profiler._dump_mutex.unlock();
+        }
+    private:
+        std::mutex _mutex;              // 保护计数表列表与汇总表
+        std::vector<Table *> _tables;
+        Table _retired;                 // 已退出线程的计数
+        std::mutex _dump_mutex;
+        std::string _dump_path;
+        size_t _dump_top;
+        int _dump_fd[2];
+        BackgroundThread _dumper;
+    };
+}
+
+#endif /* __M_PROFILER_H__ */
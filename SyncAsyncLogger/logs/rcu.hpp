@@ -0,0 +1,125 @@
+#ifndef __M_RCU_H__
+#define __M_RCU_H__
+/*
+    简化的用户态 RCU：读多写少的数据（如日志器的落地模块集合）以指针发布，读者无锁访问
+    1. 读者进入读端时将自己的槽位设置为当前纪元，离开时清零：只有两次存储与一次内存屏障，没有锁，也不写共享数据
+    2. 写者原子替换指针后推进纪元，等待仍停留在旧纪元的读者全部离开（synchronize），此后旧版本不再被任何读者引用
+    3. 读端可以嵌套；每个线程在第一次进入读端时领取一个槽位，线程退出时归还，槽位不释放，由之后的线程复用
+       写者只在复制槽位列表时持有锁，等待读者期间不持有，线程的创建与退出不会被等待中的写者阻塞
+    4. 不能在读端内调用 synchronize（例如在落地模块的回调中增删落地模块），否则会等待自己
+*/
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+namespace mylog {
+    class Rcu {
+    public:
+        // 不析构：静态对象析构期间（如全局日志器停止时落地剩余日志）仍可进入读端
+        static Rcu &instance() {
+            static Rcu *rcu = new Rcu();
+            return *rcu;
+        }
+        void readLock() {
+            Reader &r = reader();
+            if (r._nest++ > 0) return;
+            r._epoch.store(_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            // 槽位的写入必须先于之后对发布指针的读取被写者看到
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        void readUnlock() {
+            Reader &r = reader();
+            if (--r._nest > 0) return;
+            r._epoch.store(0, std::memory_order_release);
+        }
+        // fork 期间持有槽位列表的锁，没有线程在领取或归还槽位
+        void prepareFork() { _mutex.lock(); }
+        // 子进程中只有调用 fork 的线程，其他线程随之消失且不会再归还槽位：除本线程外的槽位全部清空并归还
+        void afterFork(bool child) {
+            if (child) {
+                for (Reader *r : _readers) {
+                    if (r == self()) continue;
+                    r->_epoch.store(0);
+                    r->_nest = 0;
+                    r->_used = false;
+                }
+            }
+            _mutex.unlock();
+        }
+        // 等待调用之前进入读端的所有读者离开，调用前须已替换发布的指针
+        // 之后才领取槽位的线程只会读到新的指针，不需要等待，因此复制槽位列表后即可释放锁
+        void synchronize() {
+            uint64_t target = _epoch.fetch_add(1) + 1;
+            std::vector<Reader *> readers;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                readers = _readers;
+            }
+            for (Reader *r : readers) {
+                while (true) {
+                    uint64_t epoch = r->_epoch.load();
+                    if (epoch == 0 || epoch >= target) break;
+                    std::this_thread::yield();
+                }
+            }
+        }
+    private:
+        struct Reader {
+            std::atomic<uint64_t> _epoch; // 0 表示不在读端
+            size_t _nest;
+            bool _used;                   // 已被某个线程领取（受 _mutex 保护）
+            Reader(): _epoch(0), _nest(0), _used(false) {}
+        };
+        // 线程本地的登记，构造时领取槽位，线程退出时归还
+        struct Registration {
+            Reader *_reader;
+            Registration(): _reader(Rcu::instance().enroll()) { self() = _reader; }
+            ~Registration() { self() = nullptr; Rcu::instance().leave(_reader); }
+        };
+        // 本线程已领取的槽位，未领取时为空（不会触发领取）
+        static Reader *&self() {
+            static thread_local Reader *reader = nullptr;
+            return reader;
+        }
+        Rcu(): _epoch(1) {}
+        Reader &reader() {
+            static thread_local Registration reg;
+            return *reg._reader;
+        }
+        // 优先复用已归还的槽位；槽位只增不减，数量为同时存在的读者线程数的最大值
+        Reader *enroll() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (Reader *r : _readers) {
+                if (r->_used) continue;
+                r->_used = true;
+                return r;
+            }
+            _readers.push_back(new Reader());
+            _readers.back()->_used = true;
+            return _readers.back();
+        }
+        // 归还时线程已离开读端，槽位的纪元为 0，等待中的写者不会再等待它
+        void leave(Reader *r) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            r->_used = false;
+        }
+    private:
+        std::atomic<uint64_t> _epoch;
+        std::mutex _mutex;             // 保护槽位列表，写者只在复制列表时持有
+        std::vector<Reader *> _readers;
+    };
+
+    // 在作用域内处于读端
+    class RcuReadGuard {
+    public:
+        RcuReadGuard() { Rcu::instance().readLock(); }
+        ~RcuReadGuard() { Rcu::instance().readUnlock(); }
+        RcuReadGuard(const RcuReadGuard &) = delete;
+        RcuReadGuard &operator=(const RcuReadGuard &) = delete;
+    };
+}
+
+#endif /* __M_RCU_H__ */
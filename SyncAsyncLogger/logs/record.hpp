@@ -0,0 +1,393 @@
+#ifndef __M_RECORD_H__
+#define __M_RECORD_H__
+/*
+    异步日志的紧凑记录：生产者只拷贝时间、等级、线程、调用点与有效载荷，格式化交由消费者完成
+    1. 记录编码：定长头部 + 文件名 + 有效载荷 + 结构化字段 + 线程上下文，整条记录按 8 字节对齐
+    2. 格式化线程池：将一批记录按顺序切分给多个线程格式化，再按原顺序落地
+    3. 每条记录只解码一次，按每组落地模块的格式各格式化一次；依据记录头部的等级跳过不需要该记录的落地模块组
+    4. 全局有序模式：记录携带日志器内连续递增的序号，消费者在有界的重排窗口内按序号输出
+*/
+
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <sys/uio.h>
+#include "message.hpp"
+#include "format.hpp"
+#include "sink.hpp"
+#include "thread.hpp"
+
+namespace mylog {
+
+    #define RECORD_ALIGN 8
+
+    struct RecordHeader {
+        uint32_t _size;        // 整条记录的长度（包含头部与对齐填充）
+        uint32_t _line;        // 行号
+        uint32_t _file_len;    // 源码文件名长度
+        uint32_t _payload_len; // 有效载荷长度
+        int64_t _ns;           // 日志产生的时间（纳秒）
+        uint64_t _seq;         // 全局有序模式下的序号（未开启时为 0）
+        std::thread::id _tid;  // 线程ID
+        uint32_t _fields_len;  // 结构化字段编码后的长度
+        uint32_t _context_len; // 线程上下文编码的长度
+        uint16_t _field_count; // 结构化字段数量
+        uint8_t _level;        // 日志等级
+        uint8_t _route;        // 选择落地模块的等级（见 LogMsg::_route）
+    };
+
+    class Record {
+    public:
+        // 将一条日志编码为若干片段，由缓冲区一次性拷贝，返回片段数量
+        // fields 为 encodeFields 编码后的结构化字段
+        static size_t encode(RecordHeader &hdr, const char *file, size_t flen,
+            const char *payload, size_t plen, const std::string &fields, size_t field_count,
+            const char *context, size_t clen, struct iovec iov[6]) {
+            static const char padding[RECORD_ALIGN] = {0};
+            size_t raw = sizeof(RecordHeader) + flen + plen + fields.size() + clen;
+            size_t total = (raw + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN;
+            hdr._size = total;
+            hdr._file_len = flen;
+            hdr._payload_len = plen;
+            hdr._fields_len = fields.size();
+            hdr._field_count = field_count;
+            hdr._context_len = clen;
+            iov[0].iov_base = &hdr; iov[0].iov_len = sizeof(RecordHeader);
+            iov[1].iov_base = (void *)file; iov[1].iov_len = flen;
+            iov[2].iov_base = (void *)payload; iov[2].iov_len = plen;
+            iov[3].iov_base = (void *)fields.data(); iov[3].iov_len = fields.size();
+            iov[4].iov_base = (void *)context; iov[4].iov_len = clen;
+            iov[5].iov_base = (void *)padding; iov[5].iov_len = total - raw;
+            return 6;
+        }
+        // 结构化字段编码：[类型 1B][键长度 4B][键][数值 8B | 字符串长度 4B + 字符串]
+        static void encodeFields(const Field *fields, size_t count, std::string &out) {
+            out.clear();
+            for (size_t i = 0; i < count; ++i) {
+                const Field &field = fields[i];
+                uint32_t klen = field._key_len;
+                out.push_back((char)field._type);
+                out.append((const char *)&klen, sizeof(klen));
+                out.append(field._key, klen);
+                if (field._type == Field::type::STRING) {
+                    uint32_t vlen = field._len;
+                    out.append((const char *)&vlen, sizeof(vlen));
+                    out.append(field._value._str, vlen);
+                } else {
+                    out.append((const char *)&field._value, sizeof(field._value));
+                }
+            }
+        }
+        // 从 data 处解码一条记录到 msg 中，返回记录长度；文件名与有效载荷指向缓冲区
+        // 结构化字段解码到 fields 中，字段中的字符串指向缓冲区，只在缓冲区被重置之前有效
+        static size_t decode(const char *data, LogMsg &msg, std::vector<Field> &fields) {
+            RecordHeader hdr;
+            memcpy(&hdr, data, sizeof(hdr));
+            const char *file = data + sizeof(RecordHeader);
+            msg._ns = hdr._ns;
+            msg._ctime = hdr._ns / NS_PER_SEC;
+            msg._level = (LogLevel::value)hdr._level;
+            msg._route = (LogLevel::value)hdr._route;
+            msg._line = hdr._line;
+            msg._tid = hdr._tid;
+            msg._file = file;
+            msg._file_len = hdr._file_len;
+            msg._payload = file + hdr._file_len;
+            msg._payload_len = hdr._payload_len;
+            fields.resize(hdr._field_count);
+            const char *p = file + hdr._file_len + hdr._payload_len;
+            for (auto &field : fields) {
+                uint32_t klen;
+                field._type = (Field::type)*p++;
+                memcpy(&klen, p, sizeof(klen)); p += sizeof(klen);
+                field._key = p; field._key_len = klen; p += klen;
+                if (field._type == Field::type::STRING) {
+                    uint32_t vlen;
+                    memcpy(&vlen, p, sizeof(vlen)); p += sizeof(vlen);
+                    field._value._str = p; field._len = vlen; p += vlen;
+                } else {
+                    memcpy(&field._value, p, sizeof(field._value)); p += sizeof(field._value);
+                }
+            }
+            msg._fields = fields.data();
+            msg._field_count = fields.size();
+            msg._context = p;
+            msg._context_len = hdr._context_len;
+            return hdr._size;
+        }
+        // 获取 data 处记录的长度
+        static size_t size(const char *data) {
+            uint32_t size;
+            memcpy(&size, data, sizeof(size));
+            return size;
+        }
+        // 获取 data 处记录的等级，无需解码整条记录
+        static LogLevel::value level(const char *data) {
+            return (LogLevel::value)*(const uint8_t *)(data + offsetof(RecordHeader, _level));
+        }
+        // 获取 data 处记录选择落地模块的等级
+        static LogLevel::value route(const char *data) {
+            return (LogLevel::value)*(const uint8_t *)(data + offsetof(RecordHeader, _route));
+        }
+        static uint64_t seq(const char *data) {
+            uint64_t seq;
+            memcpy(&seq, data + offsetof(RecordHeader, _seq), sizeof(seq));
+            return seq;
+        }
+        static time_t ctime(const char *data) {
+            int64_t ns;
+            memcpy(&ns, data + offsetof(RecordHeader, _ns), sizeof(ns));
+            return ns / NS_PER_SEC;
+        }
+    };
+
+    // 重排窗口：生产者在拷贝进缓冲区之前获取序号，取号与加锁之间可能被其他线程抢先，缓冲区中的顺序不一定是取号顺序
+    // 1. 消费者将每批记录暂存，按序号排序后输出连续的部分，遇到缺口则等待迟到的记录
+    // 2. 缺口之后的记录暂存超过 window_ms 毫秒后不再等待，直接越过缺口输出；之后才到的记录立即输出并计入 late()
+    class Reorder {
+    public:
+        using ptr = std::shared_ptr<Reorder>;
+        Reorder(size_t window_ms): _window(window_ms), _next(0), _late(0) {}
+        // 暂存一批记录
+        void add(const char *data, size_t len) {
+            int64_t now = nowMs();
+            size_t pos = 0;
+            while (pos < len) {
+                size_t size = Record::size(data + pos);
+                _slots.push_back(Slot{Record::seq(data + pos), now, _held.size(), size});
+                _held.append(data + pos, size);
+                pos += size;
+            }
+        }
+        // 将可以输出的记录按序号顺序追加到 out，并在 batch 中记录其时间与等级；force 为真时输出全部暂存的记录
+        void take(std::string &out, LogBatch &batch, bool force) {
+            if (_slots.empty()) return;
+            // 同一线程的记录序号递增，暂存的记录基本有序，插入排序接近线性
+            for (size_t i = 1; i < _slots.size(); ++i) {
+                Slot slot = _slots[i];
+                size_t j = i;
+                for (; j > 0 && _slots[j - 1]._seq > slot._seq; --j) _slots[j] = _slots[j - 1];
+                _slots[j] = slot;
+            }
+            int64_t now = nowMs();
+            size_t i = 0;
+            for (; i < _slots.size(); ++i) {
+                const Slot &slot = _slots[i];
+                if (slot._seq > _next && !force && now - slot._arrive < (int64_t)_window) break;
+                const char *rec = _held.data() + slot._offset;
+                out.append(rec, slot._size);
+                batch.add(Record::ctime(rec), Record::level(rec));
+                if (slot._seq < _next) ++_late;
+                else _next = slot._seq + 1;
+            }
+            if (i == 0) return;
+            // 压缩暂存区，只保留尚未输出的记录
+            std::string rest;
+            for (size_t k = i; k < _slots.size(); ++k) {
+                Slot &slot = _slots[k];
+                rest.append(_held.data() + slot._offset, slot._size);
+                slot._offset = rest.size() - slot._size;
+            }
+            _held.swap(rest);
+            _slots.erase(_slots.begin(), _slots.begin() + i);
+        }
+        bool empty() const { return _slots.empty(); }
+        // 子进程中丢弃父进程暂存的记录，从 next 开始等待本进程的记录
+        void restart(uint64_t next) {
+            _held.clear();
+            _slots.clear();
+            _next = next;
+        }
+        // 越过缺口之后才到达、因此未能按序输出的记录数量
+        uint64_t late() const { return _late; }
+    private:
+        struct Slot {
+            uint64_t _seq;
+            int64_t _arrive; // 进入暂存区的时间（毫秒）
+            size_t _offset;  // 在暂存区中的偏移
+            size_t _size;
+        };
+        static int64_t nowMs() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    private:
+        size_t _window;
+        uint64_t _next;          // 下一个应当输出的序号
+        uint64_t _late;
+        std::string _held;       // 暂存的记录
+        std::vector<Slot> _slots;
+    };
+
+    // 格式化线程池：消费线程自身也参与格式化，因此 threads 为 1 时不创建额外线程
+    class FormatPool {
+    public:
+        using ptr = std::shared_ptr<FormatPool>;
+        // 每组格式化结果按段的顺序以多段内存交给落地模块，不再拼接；组内有落地模块需要逐条信息时同时给出每条日志
+        using Output = std::function<void(const SinkGroup &, const struct iovec *, size_t, const LogRecord *, size_t)>;
+        FormatPool(size_t threads): _stop(false), _generation(0), _pending(0), _active(0), _groups(nullptr), _logger(nullptr),
+            _tasks(threads == 0 ? 1 : threads), _threads(_tasks.size() - 1) {
+            for (size_t i = 0; i < _threads.size(); ++i) {
+                _threads[i].start(std::bind(&FormatPool::threadEntry, this, i + 1, (size_t)0));
+            }
+        }
+        ~FormatPool() {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond_work.notify_all();
+            for (auto &thr : _threads) thr.join();
+        }
+        // fork 之前由消费线程空闲的日志器调用：格式化线程都在等待新的一批记录，持有 _mutex 直到 afterFork
+        void prepareFork() { _mutex.lock(); }
+        // 子进程中格式化线程已不存在：重新初始化条件变量，丢弃父进程中线程的句柄后启动新的格式化线程
+        void afterFork(bool child) {
+            if (child) {
+                _pending = 0;
+                _cond_work.reinit();
+                _cond_done.reinit();
+                for (size_t i = 0; i < _threads.size(); ++i) {
+                    _threads[i].reset();
+                    _threads[i].start(std::bind(&FormatPool::threadEntry, this, i + 1, _generation));
+                }
+            }
+            _mutex.unlock();
+        }
+        // 格式化 [data, data + len) 中的所有记录，并按原顺序将每组的结果交给 out 落地
+        void format(const char *data, size_t len, const std::vector<SinkGroup> &groups,
+            const std::string &logger, const Output &out) {
+            if (len == 0) return;
+            // 1. 按字节数将记录切分为连续的若干段，段内与段间都保持原有顺序
+            size_t count = _tasks.size();
+            size_t per = len / count + 1, pos = 0, idx = 0;
+            for (auto &task : _tasks) task._begin = task._end = data + len;
+            while (pos < len && idx < count) {
+                Task &task = _tasks[idx++];
+                task._begin = data + pos;
+                size_t limit = pos + per;
+                while (pos < len && (pos < limit || idx == count)) pos += Record::size(data + pos);
+                task._end = data + pos;
+            }
+            // 2. 唤醒其他格式化线程，消费线程自身处理第一段
+            if (idx > 1) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _groups = &groups;
+                _logger = &logger;
+                _pending = idx - 1;
+                _active = idx;
+                ++_generation;
+                _cond_work.notify_all();
+            }
+            run(_tasks[0], groups, logger);
+            if (idx > 1) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond_done.wait(lock, [&](){ return _pending == 0; });
+            }
+            // 3. 每组的各段结果作为一批落地
+            for (size_t g = 0; g < groups.size(); ++g) {
+                _iov.clear();
+                _recs.clear();
+                for (size_t i = 0; i < idx; ++i) {
+                    const LogStream &str = *_tasks[i]._outs[g];
+                    if (str.size() == 0) continue;
+                    struct iovec iov;
+                    iov.iov_base = (void *)str.data();
+                    iov.iov_len = str.size();
+                    _iov.push_back(iov);
+                    // 格式化结束后缓冲不再增长，按记下的结束位置切分出每条日志
+                    size_t begin = 0;
+                    for (auto &mark : _tasks[i]._marks[g]) {
+                        LogRecord rec = { str.data() + begin, mark._end - begin, mark._level, mark._ns };
+                        _recs.push_back(rec);
+                        begin = mark._end;
+                    }
+                }
+                if (_iov.empty() == false) out(groups[g], _iov.data(), _iov.size(), _recs.data(), _recs.size());
+            }
+        }
+    private:
+        struct Mark {
+            size_t _end;
+            LogLevel::value _level;
+            int64_t _ns;
+        };
+        struct Task {
+            const char *_begin;
+            const char *_end;
+            std::vector<std::unique_ptr<LogStream>> _outs; // 每组落地模块一份格式化结果，缓冲跨批次复用
+            std::vector<std::vector<Mark>> _marks;         // 需要逐条信息的组中每条日志的结束位置
+            LogMsg _msg;
+            std::vector<Field> _fields;
+            Task(): _begin(nullptr), _end(nullptr), _msg(LogLevel::value::UNKNOW, 0, "", "", "") {}
+        };
+        static void run(Task &task, const std::vector<SinkGroup> &groups, const std::string &logger) {
+            while (task._outs.size() < groups.size()) task._outs.emplace_back(new LogStream());
+            task._marks.resize(groups.size());
+            for (size_t g = 0; g < groups.size(); ++g) {
+                task._outs[g]->reset();
+                task._marks[g].clear();
+            }
+            task._msg._logger = logger.data();
+            task._msg._logger_len = logger.size();
+            LogLevel::value min_level = SinkGroup::minLevel(groups);
+            for (const char *p = task._begin; p < task._end; ) {
+                LogLevel::value route = Record::route(p);
+                if (route < min_level) { p += Record::size(p); continue; }
+                p += Record::decode(p, task._msg, task._fields);
+                for (size_t g = 0; g < groups.size(); ++g) {
+                    if (route < groups[g]._level) continue;
+                    groups[g]._formatter->format(*task._outs[g], task._msg);
+                    if (groups[g]._records) {
+                        Mark mark = { task._outs[g]->size(), task._msg._level, task._msg._ns };
+                        task._marks[g].push_back(mark);
+                    }
+                }
+            }
+        }
+        // seen 为线程启动时已经分配过的批次
+        void threadEntry(size_t idx, size_t seen) {
+            while (1) {
+                const std::vector<SinkGroup> *groups;
+                const std::string *logger;
+                bool active;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _cond_work.wait(lock, [&](){ return _stop || _generation != seen; });
+                    if (_stop) break;
+                    seen = _generation;
+                    groups = _groups;
+                    logger = _logger;
+                    active = idx < _active;
+                }
+                if (active == false) continue; // 本批记录较少，没有分配到本线程
+                run(_tasks[idx], *groups, *logger);
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (--_pending == 0) _cond_done.notify_one();
+            }
+        }
+    private:
+        bool _stop;
+        size_t _generation; // 每批记录递增一次，用于唤醒格式化线程
+        size_t _pending;    // 尚未完成的段数量
+        size_t _active;     // 本批记录切分出的段数量
+        const std::vector<SinkGroup> *_groups;
+        const std::string *_logger;
+        std::vector<Task> _tasks;
+        std::vector<struct iovec> _iov; // 交给落地模块的各段结果（仅消费线程使用）
+        std::vector<LogRecord> _recs;   // 各段结果中的每条日志（仅消费线程使用）
+        std::vector<BackgroundThread> _threads;
+        std::mutex _mutex;
+        Cond _cond_work;
+        Cond _cond_done;
+    };
+}
+
+#endif /* __M_RECORD_H__ */
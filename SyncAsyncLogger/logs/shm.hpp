@@ -0,0 +1,177 @@
+#ifndef __M_SHM_H__
+#define __M_SHM_H__
+/*
+    共享内存环形队列：应用进程写入，日志收集进程 mylogd 读取并落地
+    1. 共享内存对象命名为 /mylog.<名称>.<进程ID>，位于 /dev/shm 下
+    2. 写入端只使用原子操作（进程内多线程以共享内存中的自旋锁互斥），快速路径上没有系统调用
+    3. 写入端先拷贝数据再发布写位置，进程崩溃时已发布的记录仍完整保留在共享内存中，由收集进程补齐落地
+    4. 空间不足时丢弃新日志并计数，绝不阻塞应用
+    5. 读取端先读出记录并落地，落地模块刷新之后才发布读位置（commit），收集进程在此之前退出时记录仍保留在共享内存中
+*/
+
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mylog {
+
+    #define SHM_RING_MAGIC 0x4D594C47 // "MYLG"
+    #define SHM_RING_PREFIX "mylog."
+    #define DEFAULT_SHM_RING_SIZE (4 * 1024 * 1024)
+
+    struct ShmRingHeader {
+        uint32_t _magic;
+        uint32_t _header_size;
+        uint64_t _capacity;            // 数据区大小，2 的整数次幂
+        int32_t _pid;                  // 写入端进程ID
+        char _name[64];                // 写入端指定的名称，收集进程据此选择落地文件
+        alignas(64) std::atomic<uint32_t> _lock;  // 写入端进程内多线程互斥
+        alignas(64) std::atomic<uint64_t> _head;  // 已发布的写位置
+        alignas(64) std::atomic<uint64_t> _tail;  // 收集进程的读位置
+        std::atomic<uint64_t> _dropped;            // 因空间不足丢弃的记录数量
+    };
+
+    class ShmRing {
+    public:
+        ShmRing(): _hdr(nullptr), _data(nullptr), _map_size(0), _read(0), _corrupt(false) {}
+        ~ShmRing() { detach(); }
+        // 写入端：创建共享内存环形队列，capacity 向上取整为 2 的整数次幂
+        bool create(const std::string &name, size_t capacity = DEFAULT_SHM_RING_SIZE) {
+            size_t cap = 4096;
+            while (cap < capacity) cap <<= 1;
+            _shm_name = "/" SHM_RING_PREFIX + name + "." + std::to_string(getpid());
+            int fd = shm_open(_shm_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+            if (fd < 0) return false;
+            size_t size = sizeof(ShmRingHeader) + cap;
+            if (ftruncate(fd, size) < 0 || map(fd, size) == false) {
+                close(fd);
+                shm_unlink(_shm_name.c_str());
+                return false;
+            }
+            close(fd);
+            _hdr->_header_size = sizeof(ShmRingHeader);
+            _hdr->_capacity = cap;
+            _hdr->_pid = getpid();
+            strncpy(_hdr->_name, name.c_str(), sizeof(_hdr->_name) - 1);
+            _hdr->_lock.store(0);
+            _hdr->_head.store(0);
+            _hdr->_tail.store(0);
+            _hdr->_dropped.store(0);
+            std::atomic_thread_fence(std::memory_order_release);
+            _hdr->_magic = SHM_RING_MAGIC; // 最后写入魔数，收集进程以此判断初始化完成
+            return true;
+        }
+        // 读取端：打开已存在的共享内存环形队列（shm_name 为 /dev/shm 下的文件名）
+        bool attach(const std::string &shm_name) {
+            _shm_name = "/" + shm_name;
+            int fd = shm_open(_shm_name.c_str(), O_RDWR, 0);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ShmRingHeader) || map(fd, st.st_size) == false) {
+                close(fd);
+                return false;
+            }
+            close(fd);
+            if (_hdr->_magic != SHM_RING_MAGIC || _hdr->_header_size != sizeof(ShmRingHeader) ||
+                sizeof(ShmRingHeader) + _hdr->_capacity > _map_size) {
+                detach();
+                return false;
+            }
+            _read = _hdr->_tail.load(std::memory_order_relaxed);
+            _corrupt = false;
+            return true;
+        }
+        void detach() {
+            if (_hdr != nullptr) munmap(_hdr, _map_size);
+            _hdr = nullptr;
+            _data = nullptr;
+        }
+        // 删除共享内存对象（已映射的区域仍然有效，直到 detach）
+        void unlink() { shm_unlink(_shm_name.c_str()); }
+        // 写入一条记录：[长度 4B][数据]，空间不足返回 false
+        bool push(const char *data, size_t len) {
+            uint64_t need = sizeof(uint32_t) + len;
+            if (need > _hdr->_capacity) {
+                _hdr->_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            while (_hdr->_lock.exchange(1, std::memory_order_acquire) != 0) {}
+            uint64_t head = _hdr->_head.load(std::memory_order_relaxed);
+            uint64_t tail = _hdr->_tail.load(std::memory_order_acquire);
+            bool ok = (_hdr->_capacity - (head - tail)) >= need;
+            if (ok) {
+                uint32_t len32 = len;
+                copyIn(head, (const char *)&len32, sizeof(len32));
+                copyIn(head + sizeof(len32), data, len);
+                _hdr->_head.store(head + need, std::memory_order_release);
+            }
+            _hdr->_lock.store(0, std::memory_order_release);
+            if (!ok) _hdr->_dropped.fetch_add(1, std::memory_order_relaxed);
+            return ok;
+        }
+        // 读取端：取出当前已发布的所有记录，逐条交给回调，返回读取的记录数量；读位置在 commit 时才发布
+        // 共享内存可能被其他进程写坏：长度越过已发布的写位置时视为队列损坏，停止读取（corrupt() 为真）
+        template<typename Callback>
+        size_t drain(std::string &scratch, Callback cb) {
+            if (_corrupt) return 0;
+            uint64_t head = _hdr->_head.load(std::memory_order_acquire);
+            size_t count = 0;
+            while (_read < head) {
+                uint32_t len;
+                if (head - _read < sizeof(len) || head - _read > _hdr->_capacity) { _corrupt = true; break; }
+                copyOut(_read, (char *)&len, sizeof(len));
+                if (len > head - _read - sizeof(len)) { _corrupt = true; break; }
+                scratch.resize(len);
+                copyOut(_read + sizeof(len), &scratch[0], len);
+                _read += sizeof(len) + len;
+                cb(scratch.data(), scratch.size());
+                ++count;
+            }
+            return count;
+        }
+        // 读取端：发布读位置，此前 drain 读出的记录所占空间可以被写入端复用
+        void commit() { _hdr->_tail.store(_read, std::memory_order_release); }
+        bool corrupt() const { return _corrupt; }
+        bool empty() const { return _hdr->_head.load(std::memory_order_acquire) == _hdr->_tail.load(std::memory_order_relaxed); }
+        int pid() const { return _hdr->_pid; }
+        std::string name() const { return std::string(_hdr->_name, strnlen(_hdr->_name, sizeof(_hdr->_name))); }
+        uint64_t dropped() const { return _hdr->_dropped.load(std::memory_order_relaxed); }
+    private:
+        bool map(int fd, size_t size) {
+            void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) return false;
+            _hdr = (ShmRingHeader *)addr;
+            _data = (char *)addr + sizeof(ShmRingHeader);
+            _map_size = size;
+            return true;
+        }
+        // 按环形方式拷贝，跨越数据区末尾时分两段拷贝
+        void copyIn(uint64_t pos, const char *src, size_t len) {
+            size_t idx = pos & (_hdr->_capacity - 1);
+            size_t first = std::min<size_t>(len, _hdr->_capacity - idx);
+            memcpy(_data + idx, src, first);
+            memcpy(_data, src + first, len - first);
+        }
+        void copyOut(uint64_t pos, char *dst, size_t len) {
+            size_t idx = pos & (_hdr->_capacity - 1);
+            size_t first = std::min<size_t>(len, _hdr->_capacity - idx);
+            memcpy(dst, _data + idx, first);
+            memcpy(dst + first, _data, len - first);
+        }
+    private:
+        ShmRingHeader *_hdr;
+        char *_data;
+        size_t _map_size;
+        std::string _shm_name;
+        uint64_t _read;   // 读取端已读出（尚未发布）的位置
+        bool _corrupt;
+    };
+}
+
+#endif /* __M_SHM_H__ */
@@ -8,80 +8,396 @@
 */
 
 #include <memory>
+#include <mutex>
 #include <fstream>
 #include <cassert>
 #include <sstream>
-#include <mysql_connection.h>
-#include <mysql_driver.h>
-#include <cppconn/driver.h>
-#include <cppconn/exception.h>
-#include <cppconn/resultset.h>
-#include <cppconn/statement.h>
-#include <cppconn/prepared_statement.h>
+#include <deque>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <poll.h>
 #include "util.hpp"
+#include "format.hpp"
+#include "index.hpp"
+#include "shm.hpp"
 
 namespace mylog {
+    // 一条格式化好的日志及其等级与时间戳，等级等信息不写入日志内容
+    struct LogRecord {
+        const char *_data;
+        size_t _len;
+        LogLevel::value _level;
+        int64_t _ns;
+    };
+
     class LogSink {
     public:
         using ptr = std::shared_ptr<LogSink>;
-        LogSink() {}
+        LogSink(): _level(LogLevel::value::DEBUG) {}
         virtual ~LogSink() {}
         virtual void log(const char *data, size_t len) = 0;
+        // 附带本批日志概要信息的落地接口，日志器通过此接口落地；默认忽略概要信息
+        virtual void logBatch(const char *data, size_t len, const LogBatch & /*batch*/) { log(data, len); }
+        // 分散在多段内存中的一批日志（按顺序拼接，每段都以完整的日志结束），日志器将自身的缓冲直接交给落地模块，不再拼接
+        // 默认逐段调用 logBatch；基于描述符的落地模块可重写为一次 writev / sendmsg
+        virtual void logBatchv(const struct iovec *iov, size_t cnt, const LogBatch &batch) {
+            for (size_t i = 0; i < cnt; ++i) logBatch((const char *)iov[i].iov_base, iov[i].iov_len, batch);
+        }
+        // 将落地模块自身缓冲的数据交给操作系统
+        virtual void flush() {}
+        // 刷新并持久化到存储设备（fsync），默认只刷新
+        virtual void sync() { flush(); }
+        // 逐条附带等级与时间戳的一批日志，wantsRecords 为真的落地模块由日志器通过此接口落地；默认按顺序逐条调用 logBatch
+        virtual void logRecords(const LogRecord *recs, size_t cnt, const LogBatch &batch) {
+            for (size_t i = 0; i < cnt; ++i) logBatch(recs[i]._data, recs[i]._len, batch);
+        }
+        // 为真时该落地模块需要区分每条日志的等级或时间戳（如 ConsoleSink 按等级分流与着色）
+        virtual bool wantsRecords() const { return false; }
+        // fork 之后分别在父子进程中调用（此前已刷新，子进程中只有调用 fork 的线程），默认父子进程共享继承的描述符
+        virtual void afterFork(bool /*child*/) {}
+        // 为落地模块单独设置输出格式，未设置时使用日志器的格式（须在添加到日志器之前设置）
+        void setPattern(const std::string &pattern) { _formatter = std::make_shared<Formatter>(pattern); }
+        const Formatter::ptr &formatter() const { return _formatter; }
+        // 落地模块的最低输出等级，低于此等级的日志不会为该落地模块格式化（须在添加到日志器之前设置）
+        void setLevel(LogLevel::value level) { _level = level; }
+        LogLevel::value level() const { return _level; }
+        // 落地模块自身的锁：日志器写入、刷新落地模块时加锁，同一落地模块可以被多个日志器共享
+        std::mutex &mutex() { return _sink_mutex; }
+    protected:
+        Formatter::ptr _formatter;
+        LogLevel::value _level;
+        std::mutex _sink_mutex;
+    };
+
+    class Combiner;
+    // 输出格式与等级都相同的落地模块分为一组：每条日志（异步时每批日志）每种格式只格式化一次
+    struct SinkGroup {
+        Formatter::ptr _formatter;
+        LogLevel::value _level;
+        std::vector<LogSink::ptr> _sinks;
+        bool _records;                       // 组内有落地模块需要逐条的等级与时间戳
+        std::shared_ptr<Combiner> _combiner; // 同步日志器中该组的合并者
+        SinkGroup(): _level(LogLevel::value::DEBUG), _records(false) {}
+        // 将一批日志交给组内所有落地模块：iov 为按顺序的多段内存，recs 为其中的每条日志（仅在 _records 为真时需要）
+        void write(const struct iovec *iov, size_t cnt, const LogRecord *recs, size_t nrec, const LogBatch &batch) const {
+            for (auto &sink : _sinks) {
+                std::unique_lock<std::mutex> lock(sink->mutex());
+                if (sink->wantsRecords()) sink->logRecords(recs, nrec, batch);
+                else if (cnt == 1) sink->logBatch((const char *)iov[0].iov_base, iov[0].iov_len, batch);
+                else sink->logBatchv(iov, cnt, batch);
+            }
+        }
+        // 按格式与等级对落地模块分组，没有单独设置格式的落地模块使用默认格式
+        static std::vector<SinkGroup> group(const Formatter::ptr &formatter, const std::vector<LogSink::ptr> &sinks) {
+            std::vector<SinkGroup> groups;
+            for (auto &sink : sinks) {
+                Formatter::ptr fmt = sink->formatter() ? sink->formatter() : formatter;
+                auto it = groups.begin();
+                for (; it != groups.end(); ++it) {
+                    if (it->_level == sink->level() && it->_formatter->pattern() == fmt->pattern()) break;
+                }
+                if (it == groups.end()) {
+                    groups.push_back(SinkGroup());
+                    it = groups.end() - 1;
+                    it->_formatter = fmt;
+                    it->_level = sink->level();
+                }
+                it->_sinks.push_back(sink);
+                if (sink->wantsRecords()) it->_records = true;
+            }
+            return groups;
+        }
+        static bool hasRecords(const std::vector<SinkGroup> &groups) {
+            for (auto &group : groups) {
+                if (group._records) return true;
+            }
+            return false;
+        }
+        // 所有落地模块中最低的输出等级，低于此等级的日志在格式化之前即可丢弃
+        static LogLevel::value minLevel(const std::vector<SinkGroup> &groups) {
+            LogLevel::value level = LogLevel::value::OFF;
+            for (auto &group : groups) {
+                if (group._level < level) level = group._level;
+            }
+            return level;
+        }
+    };
+
+    // 日志器当前的落地模块集合：发布后不再修改，增删落地模块时整体替换
+    struct SinkSet {
+        std::vector<SinkGroup> _groups;
+        LogLevel::value _sink_level; // 所有落地模块中最低的输出等级
+        SinkSet(const std::vector<SinkGroup> &groups): _groups(groups), _sink_level(SinkGroup::minLevel(groups)) {}
     };
 
     // 落地方向：标准输出
     class StdoutSink : public LogSink {
     public:
         // 将日志消息写入到标准输出
-        void log(const char *data, size_t len) {
-            std::cout.write(data, len);
+        void log(const char *data, size_t len);
+        void flush() override { std::cout.flush(); }
+    };
+    // 落地方向：控制台（容器中主要的日志通道），不依赖 std::cout，读端缓慢时不阻塞
+    // 1. ERROR 及以上写入标准错误，其余写入标准输出；每条日志的等级由日志器通过 logRecords 传入，不写入日志内容
+    // 2. 输出到终端时按等级着色（预先生成的 ANSI 序列），重定向到文件或管道时不着色
+    // 3. 管道与终端重新打开 /proc/self/fd/N 得到独立的打开文件描述并设置 O_NONBLOCK，不影响共享该终端的其他进程；
+    //    套接字以 MSG_DONTWAIT 发送；普通文件照常写入
+    // 4. 写不完的数据留在积压缓冲中，下次落地或刷新时继续写；积压超过上限后新的日志被丢弃并计数
+    #define CONSOLE_MAX_BACKLOG (4 * 1024 * 1024)
+    #define CONSOLE_FLUSH_MS 50 // 刷新时等待控制台可写的最长时间
+    class ConsoleSink : public LogSink {
+    public:
+        ConsoleSink(bool color = true, size_t max_backlog = CONSOLE_MAX_BACKLOG) {
+            _out[0].open(STDOUT_FILENO, color, max_backlog);
+            _out[1].open(STDERR_FILENO, color, max_backlog);
+        }
+        ~ConsoleSink() {
+            for (auto &out : _out) {
+                out.drain(CONSOLE_FLUSH_MS * 20);
+                out.close();
+            }
+        }
+        bool wantsRecords() const override { return true; }
+        void logRecords(const LogRecord *recs, size_t cnt, const LogBatch & /*batch*/) override {
+            for (size_t i = 0; i < cnt; ++i) {
+                _out[recs[i]._level >= LogLevel::value::ERROR ? 1 : 0].append(recs[i]._data, recs[i]._len, recs[i]._level);
+            }
+            for (auto &out : _out) out.write();
+        }
+        // 不经过日志器直接写入时没有等级信息，写入标准输出且不着色
+        void log(const char *data, size_t len);
+        void flush() override {
+            for (auto &out : _out) out.drain(CONSOLE_FLUSH_MS);
+        }
+        // 子进程中积压的数据由父进程写出
+        void afterFork(bool child) override {
+            if (!child) return;
+            for (auto &out : _out) out.reset();
         }
+        // 因积压超出上限而丢弃的日志条数
+        size_t dropped() const { return _out[0]._dropped + _out[1]._dropped; }
+    private:
+        static const char *color(LogLevel::value level) {
+            static const char *colors[] = {
+                "",             // UNKNOW
+                "\033[36m",     // DEBUG 青色
+                "\033[32m",     // INFO 绿色
+                "\033[33m",     // WARN 黄色
+                "\033[31m",     // ERROR 红色
+                "\033[1;41m",   // FATAL 红底加粗
+                ""              // OFF
+            };
+            int idx = (int)level;
+            return idx >= 0 && idx < (int)(sizeof(colors) / sizeof(colors[0])) ? colors[idx] : "";
+        }
+        struct Stream {
+            int _fd;          // 写入使用的描述符
+            bool _own;        // 重新打开的独立描述符，析构时关闭
+            bool _sock;
+            bool _color;
+            size_t _max;
+            std::string _buf; // 积压缓冲
+            size_t _off;      // 积压缓冲中已写出的长度
+            size_t _dropped;
+            Stream(): _fd(-1), _own(false), _sock(false), _color(false), _max(0), _off(0), _dropped(0) {}
+            void open(int fd, bool color, size_t max) {
+                _fd = fd;
+                _max = max;
+                _color = color && isatty(fd);
+                struct stat st;
+                if (fstat(fd, &st) < 0) return;
+                if (S_ISSOCK(st.st_mode)) {
+                    _sock = true;
+                } else if (S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode)) {
+                    // 失败时（如管道没有读端）退回阻塞写入原描述符
+                    std::string path = "/proc/self/fd/" + std::to_string(fd);
+                    int nfd = ::open(path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+                    if (nfd >= 0) {
+                        _fd = nfd;
+                        _own = true;
+                    }
+                }
+            }
+            void close() {
+                if (_own) ::close(_fd);
+                _own = false;
+            }
+            void append(const char *data, size_t len, LogLevel::value level) {
+                if (len == 0) return;
+                if (_buf.size() - _off + len > _max) {
+                    ++_dropped;
+                    return;
+                }
+                const char *c = _color ? color(level) : "";
+                if (*c == '\0') {
+                    _buf.append(data, len);
+                    return;
+                }
+                // 颜色在换行之前结束，避免影响之后的终端输出
+                size_t body = data[len - 1] == '\n' ? len - 1 : len;
+                _buf.append(c).append(data, body).append("\033[0m");
+                if (body < len) _buf.push_back('\n');
+            }
+            // 写出积压的数据直到描述符不可写，返回是否全部写出
+            bool write() {
+                while (_off < _buf.size()) {
+                    ssize_t ret = _sock ? send(_fd, _buf.data() + _off, _buf.size() - _off, MSG_DONTWAIT | MSG_NOSIGNAL)
+                        : ::write(_fd, _buf.data() + _off, _buf.size() - _off);
+                    if (ret < 0) {
+                        if (errno == EINTR) continue;
+                        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                        reset(); // 读端已关闭等错误，积压的数据无法再写出
+                        return true;
+                    }
+                    _off += ret;
+                }
+                if (_off == _buf.size()) {
+                    reset();
+                    return true;
+                }
+                // 已写出的部分超过一半时压缩积压缓冲
+                if (_off > _buf.size() / 2) {
+                    _buf.erase(0, _off);
+                    _off = 0;
+                }
+                return false;
+            }
+            // 在 timeout_ms 毫秒内尽量写出全部积压的数据
+            void drain(int timeout_ms) {
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+                while (write() == false) {
+                    int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+                    if (left <= 0) return;
+                    struct pollfd pfd;
+                    pfd.fd = _fd;
+                    pfd.events = POLLOUT;
+                    pfd.revents = 0;
+                    if (poll(&pfd, 1, left) <= 0) return;
+                }
+            }
+            void reset() {
+                _buf.clear();
+                _off = 0;
+            }
+        };
+    private:
+        Stream _out[2]; // 标准输出、标准错误
     };
     // 落地方向：指定文件
     class FileSink : public LogSink {
     public:
-        // 构造时传入文件名，并打开文件，将操作句柄管理起来
-        FileSink(const std::string &pathname):_pathname(pathname) {
+        // 构造时传入文件名，并打开文件，将操作句柄管理起来；index 为真时同时生成旁路索引 <pathname>.idx
+        FileSink(const std::string &pathname, bool index = false):_pathname(pathname), _index_on(index), _shared(false) {
             // 1. 创建日志文件所在目录
             util::File::createDirectory(util::File::path(pathname));
             // 2. 创建并打开日志文件
             _ofs.open(_pathname, std::ios::binary | std::ios::app);
             assert(_ofs.is_open());
+            if (_index_on) _index.open(_pathname, util::File::size(_pathname));
         }
         // 将日志消息写入到指定文件
-        void log(const char *data, size_t len) {
+        void log(const char *data, size_t len);
+        void logBatch(const char *data, size_t len, const LogBatch &batch) override {
             _ofs.write(data, len);
             assert(_ofs.good());
+            if (_shared) _ofs.flush();
+            if (_index_on) _index.add(len, batch);
+        }
+        // 各段写入文件流的缓冲，整批记录一次索引
+        void logBatchv(const struct iovec *iov, size_t cnt, const LogBatch &batch) override {
+            size_t len = 0;
+            for (size_t i = 0; i < cnt; ++i) {
+                _ofs.write((const char *)iov[i].iov_base, iov[i].iov_len);
+                len += iov[i].iov_len;
+            }
+            assert(_ofs.good());
+            if (_shared) _ofs.flush();
+            if (_index_on) _index.add(len, batch);
+        }
+        void flush() override { _ofs.flush(); }
+        void sync() override {
+            _ofs.flush();
+            util::File::sync(_pathname);
+        }
+        // fork 之后子进程以 O_APPEND 与父进程共享同一个文件：每批日志立即写出，避免缓冲区在行中间写出造成交错
+        // 子进程无法得知父进程写入的偏移，不再生成旁路索引；父进程保持原有的缓冲与索引
+        void afterFork(bool child) override {
+            if (!child) return;
+            _shared = true;
+            _index_on = false;
+            _index.abandon();
         }
     private:
         std::string _pathname;
         std::ofstream _ofs;
+        bool _index_on;
+        IndexWriter _index;
+        bool _shared; // 已经与其他进程共享
     };
     // 落地方向：滚动文件 （以大小进行滚动）
     class RollBySizeSink : public LogSink {
     public:
         // 构造时传入文件名，并打开文件，将操作句柄管理起来
-        RollBySizeSink(const std::string &basename, size_t max_size):
-            _basename(basename), _max_fsize(max_size), _cur_fsize(0), _name_count(0) {
-            std::string pathname = createNewFile();
+        // index 为真时为每个滚动文件生成旁路索引 <文件名>.idx
+        RollBySizeSink(const std::string &basename, size_t max_size, bool index = false):
+            _name_count(0), _basename(basename), _max_fsize(max_size), _cur_fsize(0), _index_on(index), _shared(false) {
+            _pathname = createNewFile();
             // 1. 创建日志文件所在目录
-            util::File::createDirectory(util::File::path(pathname));
+            util::File::createDirectory(util::File::path(_pathname));
             // 2. 创建并打开日志文件
-            _ofs.open(pathname, std::ios::binary | std::ios::app);
+            _ofs.open(_pathname, std::ios::binary | std::ios::app);
+            if (_index_on) _index.open(_pathname, util::File::size(_pathname));
         }
         // 将日志消息写入到标准输出 -- 写入前判断文件大小，超过了最大大小就要切换文件
-        void log(const char *data, size_t len) {
+        void log(const char *data, size_t len);
+        void logBatch(const char *data, size_t len, const LogBatch &batch) override {
+            struct iovec iov;
+            iov.iov_base = (void *)data;
+            iov.iov_len = len;
+            logBatchv(&iov, 1, batch);
+        }
+        // 整批写入同一个文件，写入前判断是否需要滚动
+        void logBatchv(const struct iovec *iov, size_t cnt, const LogBatch &batch) override {
             if (_cur_fsize >= _max_fsize) {
                 _ofs.close(); // 关闭原来已经打开的文件
-                std::string pathname = createNewFile();
-                util::File::createDirectory(util::File::path(pathname));
-                _ofs.open(pathname, std::ios::binary | std::ios::app);
+                _pathname = createNewFile();
+                util::File::createDirectory(util::File::path(_pathname));
+                _ofs.open(_pathname, std::ios::binary | std::ios::app);
                 assert(_ofs.is_open());
                 _cur_fsize = 0;
+                if (_index_on) _index.open(_pathname, util::File::size(_pathname));
+            }
+            size_t len = 0;
+            for (size_t i = 0; i < cnt; ++i) {
+                _ofs.write((const char *)iov[i].iov_base, iov[i].iov_len);
+                len += iov[i].iov_len;
             }
-            _ofs.write(data, len);
             assert(_ofs.good());
+            if (_shared) _ofs.flush();
             _cur_fsize += len;
+            if (_index_on) _index.add(len, batch);
+        }
+        void flush() override { _ofs.flush(); }
+        void sync() override {
+            _ofs.flush();
+            util::File::sync(_pathname);
+        }
+        // 同 FileSink；各进程按各自写入的大小独立滚动，多进程写同一组滚动文件时应使用 SharedRollBySizeSink
+        void afterFork(bool child) override {
+            if (!child) return;
+            _shared = true;
+            _index_on = false;
+            _index.abandon();
         }
     private:
         // 进行大小判断，超过指定大小则创建新文件
@@ -107,225 +423,514 @@ namespace mylog {
         // 通过基础文件名 + 扩展文件名（以时间生产）组成一个实际的当前输出文件名
         size_t _name_count;
         std::string _basename; // ./logs/base~       -> ./logs/base-202507101232.log
+        std::string _pathname; // 当前输出的文件名
         std::ofstream _ofs;
         size_t _max_fsize; // 记录文件最大大小，当前文件超过了这个大小就要切换文件
         size_t _cur_fsize; // 记录当前文件已经写入的数据大小
+        bool _index_on;
+        IndexWriter _index;
+        bool _shared;
     };
 
-// 落地方向：MySQL数据库
-    class MySQLSink : public LogSink {
+    // 多进程共享文件的写入：每批日志一次 O_APPEND 写入，多个进程同时追加时不会出现行交错
+    #define SHARED_MAX_IOV 64 // 每次 writev 最多的片段数量
+    class SharedFile {
     public:
-        // 构造时传入数据库连接信息，创建数据库连接和日志表
-        MySQLSink(const std::string &host, const std::string &user, const std::string &password, 
-                  const std::string &database, int port = 3306) 
-            : _host(host), _user(user), _password(password), _database(database), _port(port) {
-            
-            try {
-                // 1. 获取MySQL驱动实例
-                _driver = sql::mysql::get_mysql_driver_instance();
-                
-                // 2. 创建数据库连接
-                std::stringstream connection_string;
-                connection_string << "tcp://" << _host << ":" << _port;
-                _connection.reset(_driver->connect(connection_string.str(), _user, _password));
-                
-                // 3. 选择数据库
-                _connection->setSchema(_database);
-                
-                // 4. 创建日志表（如果不存在）
-                createLogTable();
-                
-                // 5. 准备插入语句
-                prepareInsertStatement();
-                
-            } catch (sql::SQLException &e) {
-                std::cerr << "MySQL connection failed: " << e.what() << std::endl;
-                std::cerr << "Error code: " << e.getErrorCode() << std::endl;
-                std::cerr << "SQL state: " << e.getSQLState() << std::endl;
-                assert(false);
-            }
-        }
-        
-        ~MySQLSink() {
-        }
-        
-        // 将日志消息写入到MySQL数据库
-        void log(const char *data, size_t len) {
-            if (!_connection || !_prep_stmt) {
-                return;
-            }
-            
-            try {
-                // 解析日志数据，提取各个字段
-                LogInfo log_info = parseLogData(data, len);
-                
-                // 绑定参数并执行插入
-                _prep_stmt->setString(1, log_info.timestamp);
-                _prep_stmt->setString(2, log_info.level);
-                _prep_stmt->setString(3, log_info.logger_name);
-                _prep_stmt->setString(4, log_info.file);
-                _prep_stmt->setInt(5, log_info.line);
-                _prep_stmt->setInt64(6, log_info.thread_id);
-                _prep_stmt->setString(7, log_info.message);
-                _prep_stmt->setString(8, std::string(data, len));
-                
-                _prep_stmt->executeUpdate();
-                
-            } catch (sql::SQLException &e) {
-                std::cerr << "Failed to insert log: " << e.what() << std::endl;
-                std::cerr << "Error code: " << e.getErrorCode() << std::endl;
-            }
-        }
-        
-    private:
-        struct LogInfo {
-            std::string timestamp;
-            std::string level;
-            std::string logger_name;
-            std::string file;
-            int line;
-            int64_t thread_id;
-            std::string message;
-        };
-        
-        void createLogTable() {
-            try {
-                std::unique_ptr<sql::Statement> stmt(_connection->createStatement());
-                
-                const std::string sql = R"(
-                    CREATE TABLE IF NOT EXISTS logs (
-                        id BIGINT AUTO_INCREMENT PRIMARY KEY,
-                        timestamp DATETIME NOT NULL,
-                        level VARCHAR(10) NOT NULL,
-                        logger_name VARCHAR(255) NOT NULL,
-                        file VARCHAR(500) NOT NULL,
-                        line INT NOT NULL,
-                        thread_id BIGINT NOT NULL,
-                        message TEXT NOT NULL,
-                        raw_log TEXT NOT NULL,
-                        created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
-                        INDEX idx_logs_timestamp (timestamp),
-                        INDEX idx_logs_level (level),
-                        INDEX idx_logs_logger_name (logger_name)
-                    ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-                )";
-                
-                stmt->execute(sql);
-                
-            } catch (sql::SQLException &e) {
-                std::cerr << "Failed to create table: " << e.what() << std::endl;
-                assert(false);
-            }
-        }
-        
-        void prepareInsertStatement() {
-            try {
-                const std::string sql = R"(
-                    INSERT INTO logs (timestamp, level, logger_name, file, line, thread_id, message, raw_log)
-                    VALUES (?, ?, ?, ?, ?, ?, ?, ?)
-                )";
-                
-                _prep_stmt.reset(_connection->prepareStatement(sql));
-                
-            } catch (sql::SQLException &e) {
-                std::cerr << "Failed to prepare statement: " << e.what() << std::endl;
-                assert(false);
-            }
-        }
-        
-        LogInfo parseLogData(const char *data, size_t len) {
-            LogInfo info;
-            std::string log_str(data, len);
-            
-            // 简单的日志解析，假设格式为: [timestamp][level][logger_name]file:line message
-            // 这里实现一个基本的解析器，实际使用中可能需要更复杂的解析逻辑
-            
-            // 默认值
-            info.timestamp = getCurrentTimestamp();
-            info.level = "INFO";
-            info.logger_name = "unknown";
-            info.file = "unknown";
-            info.line = 0;
-            info.thread_id = mylog::util::Thread::tid();
-            info.message = log_str;
-            
-            // 尝试解析格式化的日志
-            size_t pos = 0;
-            
-            // 解析时间戳 [timestamp]
-            if (log_str[pos] == '[') {
-                size_t end_pos = log_str.find(']', pos + 1);
-                if (end_pos != std::string::npos) {
-                    info.timestamp = log_str.substr(pos + 1, end_pos - pos - 1);
-                    pos = end_pos + 1;
+        static int open(const std::string &pathname) {
+            util::File::createDirectory(util::File::path(pathname));
+            return ::open(pathname.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        }
+        static void write(int fd, const char *data, size_t len) {
+            while (len > 0) {
+                ssize_t ret = ::write(fd, data, len);
+                if (ret < 0) {
+                    if (errno == EINTR) continue;
+                    assert(ret >= 0);
+                    return;
                 }
+                data += ret;
+                len -= ret;
+            }
+        }
+        // 多段数据每 SHARED_MAX_IOV 段一次 writev 写入
+        static void writev(int fd, const struct iovec *iov, size_t cnt) {
+            struct iovec local[SHARED_MAX_IOV];
+            while (cnt > 0) {
+                size_t n = cnt < SHARED_MAX_IOV ? cnt : SHARED_MAX_IOV;
+                memcpy(local, iov, n * sizeof(struct iovec));
+                struct iovec *p = local;
+                size_t left = n;
+                while (left > 0) {
+                    ssize_t ret = ::writev(fd, p, left);
+                    if (ret < 0) {
+                        if (errno == EINTR) continue;
+                        assert(ret >= 0);
+                        return;
+                    }
+                    // 跳过已经写出的片段，从部分写出的片段中继续
+                    size_t done = ret;
+                    while (left > 0 && done >= p->iov_len) {
+                        done -= p->iov_len;
+                        ++p;
+                        --left;
+                    }
+                    if (left > 0) {
+                        p->iov_base = (char *)p->iov_base + done;
+                        p->iov_len -= done;
+                    }
+                }
+                iov += n;
+                cnt -= n;
+            }
+        }
+    };
+    // 落地方向：多进程共享的指定文件
+    class SharedFileSink : public LogSink {
+    public:
+        SharedFileSink(const std::string &pathname): _pathname(pathname), _fd(SharedFile::open(pathname)) {
+            assert(_fd >= 0);
+        }
+        ~SharedFileSink() { if (_fd >= 0) close(_fd); }
+        void log(const char *data, size_t len);
+        void logBatchv(const struct iovec *iov, size_t cnt, const LogBatch & /*batch*/) override {
+            SharedFile::writev(_fd, iov, cnt);
+        }
+        void sync() override { fsync(_fd); }
+    private:
+        std::string _pathname;
+        int _fd;
+    };
+    // 落地方向：多进程共享的滚动文件（以大小进行滚动）
+    // 1. 所有进程追加写入同一个当前文件 <basename>current.log，写入前以 fstat 获取共享文件的实际大小
+    // 2. 超过大小时在文件锁 <basename>current.log.lock 的保护下由一个进程将当前文件改名归档，
+    //    其他进程发现当前文件已被替换后重新打开即可，无需额外的守护进程
+    // 3. flock 对共享同一打开文件的进程不互斥：fork 之后子进程第一次滚动前重新打开锁文件
+    class SharedRollBySizeSink : public LogSink {
+    public:
+        SharedRollBySizeSink(const std::string &basename, size_t max_size):
+            _basename(basename), _active(basename + "current.log"), _max_fsize(max_size), _name_count(0), _lock_fd(-1) {
+            _fd = SharedFile::open(_active);
+            assert(_fd >= 0);
+            openLock();
+            assert(_lock_fd >= 0);
+        }
+        ~SharedRollBySizeSink() {
+            if (_fd >= 0) close(_fd);
+            if (_lock_fd >= 0) close(_lock_fd);
+        }
+        void log(const char *data, size_t len);
+        void logBatchv(const struct iovec *iov, size_t cnt, const LogBatch & /*batch*/) override {
+            struct stat st;
+            if (fstat(_fd, &st) == 0 && (size_t)st.st_size >= _max_fsize) rotate(st);
+            SharedFile::writev(_fd, iov, cnt);
+        }
+        void sync() override { fsync(_fd); }
+        // 子进程重新打开当前文件与锁文件，不与父进程共享打开的文件
+        void afterFork(bool child) override {
+            if (!child) return;
+            int fd = SharedFile::open(_active);
+            if (fd >= 0) {
+                close(_fd);
+                _fd = fd;
             }
-            
-            // 解析日志级别 [level]
-            if (pos < log_str.length() && log_str[pos] == '[') {
-                size_t end_pos = log_str.find(']', pos + 1);
-                if (end_pos != std::string::npos) {
-                    info.level = log_str.substr(pos + 1, end_pos - pos - 1);
-                    pos = end_pos + 1;
+            openLock();
+        }
+    private:
+        // 每个进程以自己打开的锁文件加锁
+        void openLock() {
+            if (_lock_fd >= 0) close(_lock_fd);
+            _lock_fd = ::open((_active + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            _pid = getpid();
+        }
+        void rotate(const struct stat &cur) {
+            if (_pid != getpid()) openLock();
+            flock(_lock_fd, LOCK_EX);
+            struct stat st;
+            // 当前文件仍是本进程打开的文件，由本进程归档；否则其他进程已经完成归档，只需重新打开
+            // 以 link 归档，目标已存在时失败而不是覆盖，换下一个序号重试
+            if (stat(_active.c_str(), &st) == 0 && st.st_ino == cur.st_ino && st.st_dev == cur.st_dev) {
+                while (1) {
+                    std::string pathname = createNewFile();
+                    if (link(_active.c_str(), pathname.c_str()) == 0) {
+                        unlink(_active.c_str());
+                        break;
+                    }
+                    if (errno != EEXIST) break;
                 }
             }
-            
-            // 解析日志器名称 [logger_name]
-            if (pos < log_str.length() && log_str[pos] == '[') {
-                size_t end_pos = log_str.find(']', pos + 1);
-                if (end_pos != std::string::npos) {
-                    info.logger_name = log_str.substr(pos + 1, end_pos - pos - 1);
-                    pos = end_pos + 1;
+            int fd = SharedFile::open(_active);
+            if (fd >= 0) {
+                close(_fd);
+                _fd = fd;
+            }
+            flock(_lock_fd, LOCK_UN);
+        }
+        // 归档文件名：基础文件名 + 时间 + 序号
+        std::string createNewFile() {
+            time_t t = util::Date::now();
+            struct tm lt;
+            localtime_r(&t, &lt);
+            char stamp[32];
+            strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S", &lt);
+            return _basename + stamp + "-" + std::to_string(_name_count++) + ".log";
+        }
+    private:
+        std::string _basename;
+        std::string _active; // 所有进程共同写入的当前文件
+        size_t _max_fsize;
+        size_t _name_count;
+        int _fd;
+        int _lock_fd;
+        pid_t _pid; // 打开锁文件的进程
+    };
+
+    // 落地方向：网络（TCP / UDP / RFC5424 syslog）
+    // 1. 非阻塞套接字 + epoll，每次落地最多阻塞 budget_ms 毫秒，超时的数据留在积压队列中，下次落地时继续发送
+    // 2. TCP 将积压的多个批次合并为一次 writev 发送；UDP 按行打包为不超过 NET_MAX_DATAGRAM 的数据报
+    // 3. 连接断开后以指数退避重连，断开期间数据保存在有上限的积压队列中，超出上限时丢弃最旧的数据
+    //    地址解析失败或连续多次连接失败后，下次重连前重新解析地址（对端的地址可能已经变化）
+    // 4. syslog 报文的 PRI 由每条日志的等级得到，时间戳取自日志自身（RFC5424 格式，含 +08:00 形式的时区）
+    #define NET_MAX_DATAGRAM 8192
+    #define NET_MAX_IOV 64
+    class NetworkSink : public LogSink {
+    public:
+        enum class Protocol {
+            TCP,
+            UDP,
+            SYSLOG_UDP, // RFC5424 报文，每条日志一个数据报（RFC5426）
+            SYSLOG_TCP  // RFC5424 报文，以 octet-counting 方式分帧（RFC6587）
+        };
+        NetworkSink(const std::string &host, int port, Protocol proto = Protocol::TCP,
+            size_t budget_ms = 5, size_t max_backlog = 8 * 1024 * 1024):
+            _host(host), _port(port), _proto(proto), _budget_ms(budget_ms), _max_backlog(max_backlog),
+            _fd(-1), _epfd(epoll_create1(EPOLL_CLOEXEC)), _connecting(false), _addr_len(0),
+            _backoff_ms(NET_MIN_BACKOFF_MS), _next_connect(0), _failures(0), _backlog_size(0), _offset(0), _dropped(0) {
+            assert(_epfd >= 0);
+            resolve();
+            char name[256] = {0};
+            gethostname(name, sizeof(name) - 1);
+            _hostname = name[0] ? name : "-";
+            _pid = std::to_string(getpid());
+        }
+        ~NetworkSink() {
+            // 析构前尽量将积压的数据发送出去
+            flushBacklog(_budget_ms * 20);
+            closeSocket();
+            close(_epfd);
+        }
+        void log(const char *data, size_t len);
+        // syslog 每条日志一个报文，需要每条日志的等级与时间戳
+        bool wantsRecords() const override { return isSyslog(); }
+        void logRecords(const LogRecord *recs, size_t cnt, const LogBatch & /*batch*/) override {
+            std::string chunk;
+            for (size_t i = 0; i < cnt; ++i) {
+                size_t len = recs[i]._len;
+                if (len > 0 && recs[i]._data[len - 1] == '\n') --len;
+                appendSyslog(chunk, recs[i]._data, len, recs[i]._level, recs[i]._ns);
+            }
+            pushChunk(chunk);
+            trimBacklog();
+            flushBacklog(_budget_ms);
+        }
+        // TCP 已连接且没有积压时，各段直接以一次 sendmsg 发送，只有未发送完的部分才拷贝进积压队列
+        void logBatchv(const struct iovec *iov, size_t cnt, const LogBatch &batch) override {
+            if (_proto != Protocol::TCP || !connected() || !_backlog.empty() || cnt > NET_MAX_IOV)
+                return LogSink::logBatchv(iov, cnt, batch);
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = (struct iovec *)iov;
+            msg.msg_iovlen = cnt;
+            ssize_t ret;
+            do {
+                ret = sendmsg(_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            } while (ret < 0 && errno == EINTR);
+            if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                scheduleReconnect();
+                ret = 0;
+            }
+            size_t done = ret < 0 ? 0 : ret;
+            size_t i = 0;
+            for (; i < cnt && done >= iov[i].iov_len; ++i) done -= iov[i].iov_len;
+            if (i == cnt) return;
+            // 部分发送的片段整体进入积压队列并记录已发送的偏移，重连时整体重发
+            enqueue((const char *)iov[i].iov_base, iov[i].iov_len);
+            _offset = _fd >= 0 ? done : 0;
+            for (++i; i < cnt; ++i) enqueue((const char *)iov[i].iov_base, iov[i].iov_len);
+            flushBacklog(_budget_ms);
+        }
+        // 子进程不能继续使用父进程的连接（字节流会交错）与 epoll 实例（注销套接字会影响父进程）：
+        // 重新创建 epoll 实例，关闭继承的套接字后重新连接，积压的数据由父进程发送
+        void afterFork(bool child) override {
+            if (!child) return;
+            close(_epfd);
+            _epfd = epoll_create1(EPOLL_CLOEXEC);
+            if (_fd >= 0) close(_fd);
+            _fd = -1;
+            _connecting = false;
+            _offset = 0;
+            _backlog.clear();
+            _backlog_size = 0;
+            _backoff_ms = NET_MIN_BACKOFF_MS;
+            _next_connect = 0;
+            _failures = 0;
+            _pid = std::to_string(getpid());
+        }
+        // 因积压超出上限而丢弃的字节数
+        size_t dropped() const { return _dropped; }
+        bool connected() const { return _fd >= 0 && !_connecting; }
+    private:
+        enum { NET_MIN_BACKOFF_MS = 100, NET_MAX_BACKOFF_MS = 30000, NET_RERESOLVE_FAILURES = 3 };
+        bool isTcp() const { return _proto == Protocol::TCP || _proto == Protocol::SYSLOG_TCP; }
+        bool isSyslog() const { return _proto == Protocol::SYSLOG_UDP || _proto == Protocol::SYSLOG_TCP; }
+        static uint64_t nowMs() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        // 解析失败时保留此前的地址（若有）
+        bool resolve() {
+            struct addrinfo hints, *res = nullptr;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = isTcp() ? SOCK_STREAM : SOCK_DGRAM;
+            std::string port = std::to_string(_port);
+            if (getaddrinfo(_host.c_str(), port.c_str(), &hints, &res) != 0 || res == nullptr) {
+                std::cerr << "NetworkSink resolve failed: " << _host << ":" << _port << std::endl;
+                return false;
+            }
+            memcpy(&_addr, res->ai_addr, res->ai_addrlen);
+            _addr_len = res->ai_addrlen;
+            freeaddrinfo(res);
+            return true;
+        }
+        // 日志等级对应的 syslog severity（RFC5424 6.2.1）
+        static int severity(LogLevel::value level) {
+            switch (level) {
+                case LogLevel::value::DEBUG: return 7; // debug
+                case LogLevel::value::WARN: return 4;  // warning
+                case LogLevel::value::ERROR: return 3; // error
+                case LogLevel::value::FATAL: return 2; // critical
+                default: return 6;                     // informational
+            }
+        }
+        // RFC5424 报文头：<PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA
+        // TIMESTAMP 形如 2024-05-01T08:30:00.123456+08:00
+        void syslogHeader(std::string &out, LogLevel::value level, int64_t ns) {
+            time_t t = ns / NS_PER_SEC;
+            struct tm lt;
+            localtime_r(&t, &lt);
+            char ts[64];
+            size_t n = strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &lt);
+            long off = lt.tm_gmtoff / 60;
+            char sign = off < 0 ? '-' : '+';
+            if (off < 0) off = -off;
+            snprintf(ts + n, sizeof(ts) - n, ".%06d%c%02ld:%02ld", (int)(ns % NS_PER_SEC / 1000), sign, off / 60, off % 60);
+            // facility user(1)
+            out.append("<").append(std::to_string(8 + severity(level))).append(">1 ").append(ts).append(" ").append(_hostname);
+            out.append(" mylog ").append(_pid).append(" - - ");
+        }
+        // 追加一条 syslog 报文：TCP 以 octet-counting 分帧追加到 chunk，UDP 每条报文一个数据报
+        void appendSyslog(std::string &chunk, const char *data, size_t len, LogLevel::value level, int64_t ns) {
+            std::string msg;
+            syslogHeader(msg, level, ns);
+            msg.append(data, len);
+            if (_proto == Protocol::SYSLOG_TCP) {
+                chunk.append(std::to_string(msg.size())).append(" ").append(msg);
+            } else {
+                pushChunk(msg);
+            }
+        }
+        void pushChunk(std::string &chunk) {
+            if (chunk.empty()) return;
+            _backlog_size += chunk.size();
+            _backlog.push_back(std::string());
+            _backlog.back().swap(chunk);
+        }
+        void enqueue(const char *data, size_t len) {
+            if (_proto == Protocol::TCP) {
+                _backlog.push_back(std::string(data, len));
+                _backlog_size += len;
+            } else {
+                // 其余协议需要按行分帧；不经过日志器直接写入的 syslog 报文没有等级信息，按 informational 与当前时间发送
+                int64_t now = Clock::now();
+                std::string chunk;
+                size_t pos = 0;
+                while (pos < len) {
+                    const char *nl = (const char *)memchr(data + pos, '\n', len - pos);
+                    size_t end = nl ? (nl - data) + 1 : len;
+                    size_t line_len = end - pos;
+                    if (_proto == Protocol::UDP) {
+                        if (chunk.size() + line_len > NET_MAX_DATAGRAM) pushChunk(chunk);
+                        chunk.append(data + pos, line_len);
+                    } else {
+                        appendSyslog(chunk, data + pos, nl ? line_len - 1 : line_len, LogLevel::value::INFO, now);
+                    }
+                    pos = end;
                 }
+                pushChunk(chunk);
+            }
+            trimBacklog();
+        }
+        // 积压超出上限，丢弃最旧的完整批次（正在发送的批次除外）
+        void trimBacklog() {
+            while (_backlog_size > _max_backlog && _backlog.size() > 1) {
+                auto victim = _offset > 0 ? _backlog.begin() + 1 : _backlog.begin();
+                _backlog_size -= victim->size();
+                _dropped += victim->size();
+                _backlog.erase(victim);
+            }
+        }
+        void closeSocket() {
+            if (_fd < 0) return;
+            epoll_ctl(_epfd, EPOLL_CTL_DEL, _fd, nullptr);
+            close(_fd);
+            _fd = -1;
+            _connecting = false;
+            // 半发送的批次必须整体重发，避免对端收到残缺的行
+            _offset = 0;
+        }
+        void scheduleReconnect() {
+            closeSocket();
+            ++_failures;
+            _next_connect = nowMs() + _backoff_ms;
+            _backoff_ms = std::min<uint64_t>(_backoff_ms * 2, NET_MAX_BACKOFF_MS);
+        }
+        // 发起非阻塞连接，返回 false 表示还未到重连时间或连接失败
+        bool startConnect() {
+            if (nowMs() < _next_connect) return false;
+            if (_addr_len == 0 || _failures >= NET_RERESOLVE_FAILURES) {
+                if (resolve() == false && _addr_len == 0) { scheduleReconnect(); return false; }
+                _failures = 0;
+            }
+            _fd = socket(_addr.ss_family, (isTcp() ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (_fd < 0) { scheduleReconnect(); return false; }
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLOUT;
+            epoll_ctl(_epfd, EPOLL_CTL_ADD, _fd, &ev);
+            int ret = connect(_fd, (struct sockaddr *)&_addr, _addr_len);
+            if (ret < 0 && errno != EINPROGRESS) { scheduleReconnect(); return false; }
+            _connecting = (ret < 0);
+            if (!_connecting) {
+                _backoff_ms = NET_MIN_BACKOFF_MS;
+                _failures = 0;
+            }
+            return true;
+        }
+        // 等待套接字可写，超时或出错返回 false
+        bool waitWritable(uint64_t deadline) {
+            uint64_t now = nowMs();
+            int timeout = deadline > now ? (int)(deadline - now) : 0;
+            struct epoll_event ev;
+            int n = epoll_wait(_epfd, &ev, 1, timeout);
+            if (n <= 0) return false;
+            if (_connecting) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0) { scheduleReconnect(); return false; }
+                _connecting = false;
+                _backoff_ms = NET_MIN_BACKOFF_MS;
+                _failures = 0;
             }
-            
-            // 解析文件名和行号 file:line
-            size_t colon_pos = log_str.find(':', pos);
-            size_t space_pos = log_str.find(' ', pos);
-            if (colon_pos != std::string::npos && space_pos != std::string::npos && colon_pos < space_pos) {
-                info.file = log_str.substr(pos, colon_pos - pos);
-                std::string line_str = log_str.substr(colon_pos + 1, space_pos - colon_pos - 1);
-                try {
-                    info.line = std::stoi(line_str);
-                } catch (...) {
-                    info.line = 0;
+            return true;
+        }
+        void flushBacklog(size_t budget_ms) {
+            uint64_t deadline = nowMs() + budget_ms;
+            while (!_backlog.empty()) {
+                if (_fd < 0 && startConnect() == false) return;
+                if (_connecting && waitWritable(deadline) == false) return;
+                ssize_t ret;
+                if (isTcp()) {
+                    // 合并多个批次，一次系统调用发送
+                    struct iovec iov[NET_MAX_IOV];
+                    int cnt = 0;
+                    for (auto it = _backlog.begin(); it != _backlog.end() && cnt < NET_MAX_IOV; ++it, ++cnt) {
+                        size_t skip = (cnt == 0) ? _offset : 0;
+                        iov[cnt].iov_base = (void *)(it->data() + skip);
+                        iov[cnt].iov_len = it->size() - skip;
+                    }
+                    struct msghdr msg;
+                    memset(&msg, 0, sizeof(msg));
+                    msg.msg_iov = iov;
+                    msg.msg_iovlen = cnt;
+                    ret = sendmsg(_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+                } else {
+                    ret = send(_fd, _backlog.front().data(), _backlog.front().size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                    // UDP 对端不可达时丢弃该数据报即可，不影响后续发送
+                    if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ret = _backlog.front().size();
                 }
-                pos = space_pos + 1;
-            }
-            
-            // 剩余部分作为消息内容
-            if (pos < log_str.length()) {
-                info.message = log_str.substr(pos);
-                // 移除末尾的换行符
-                if (!info.message.empty() && info.message.back() == '\n') {
-                    info.message.pop_back();
+                if (ret < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        if (waitWritable(deadline) == false) return;
+                        continue;
+                    }
+                    scheduleReconnect();
+                    return;
                 }
+                consume(ret);
+                if (nowMs() >= deadline) return;
             }
-            
-            return info;
         }
-        
-        std::string getCurrentTimestamp() {
-            time_t now = time(nullptr);
-            struct tm *tm_info = localtime(&now);
-            char buffer[20];
-            strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", tm_info);
-            return std::string(buffer);
+        // 从积压队列头部移除已发送的数据
+        void consume(size_t len) {
+            while (len > 0 && !_backlog.empty()) {
+                size_t left = _backlog.front().size() - _offset;
+                if (len < left) { _offset += len; return; }
+                len -= left;
+                _backlog_size -= _backlog.front().size();
+                _backlog.pop_front();
+                _offset = 0;
+            }
         }
-        
     private:
         std::string _host;
-        std::string _user;
-        std::string _password;
-        std::string _database;
         int _port;
-        
-        sql::mysql::MySQL_Driver *_driver;
-        std::unique_ptr<sql::Connection> _connection;
-        std::unique_ptr<sql::PreparedStatement> _prep_stmt;
+        Protocol _proto;
+        size_t _budget_ms;     // 每次落地允许阻塞的最长时间
+        size_t _max_backlog;   // 积压队列的最大字节数
+        int _fd;
+        int _epfd;
+        bool _connecting;      // 非阻塞连接尚未完成
+        struct sockaddr_storage _addr;
+        socklen_t _addr_len;
+        uint64_t _backoff_ms;  // 当前的重连退避时间
+        uint64_t _next_connect;
+        size_t _failures;      // 连续连接失败的次数，达到 NET_RERESOLVE_FAILURES 后重新解析地址
+        std::deque<std::string> _backlog; // 待发送的批次
+        size_t _backlog_size;
+        size_t _offset;        // 队首批次已发送的字节数
+        size_t _dropped;
+        std::string _hostname;
+        std::string _pid;
+    };
+
+    // 落地方向：共享内存环形队列，由日志收集进程 mylogd 落地到文件
+    // 写入过程没有系统调用，磁盘的抖动不会影响应用；队列满时丢弃新日志，可通过 dropped() 查询
+    class ShmSink : public LogSink {
+    public:
+        ShmSink(const std::string &name, size_t capacity = DEFAULT_SHM_RING_SIZE): _name(name), _capacity(capacity) {
+            bool ret = _ring.create(name, capacity);
+            assert(ret);
+            (void)ret;
+        }
+        // 共享内存以进程ID命名，mylogd 据此判断写入端是否存活：子进程创建自己的环形队列
+        void afterFork(bool child) override {
+            if (!child) return;
+            _ring.detach();
+            bool ret = _ring.create(_name, _capacity);
+            assert(ret);
+            (void)ret;
+        }
+        // 共享内存对象由 mylogd 在落地完剩余日志后删除
+        void log(const char *data, size_t len);
+        uint64_t dropped() const { return _ring.dropped(); }
+    private:
+        std::string _name;
+        size_t _capacity;
+        ShmRing _ring;
     };
 
-    
     class SinkFactory {
     public:
         template<typename SinkType, typename ...Args>
@@ -334,7 +939,46 @@ namespace mylog {
         }
     };
 
-}
+    // 落地接口定义在类外，虚函数表随之只在定义所在的编译单元生成（MYLOG_USE_LIBRARY 时即 libmylog）
+#if !defined(MYLOG_USE_LIBRARY) || defined(MYLOG_LIBRARY_SOURCE)
+    MYLOG_INLINE void StdoutSink::log(const char *data, size_t len) {
+        std::cout.write(data, len);
+    }
+
+    MYLOG_INLINE void ConsoleSink::log(const char *data, size_t len) {
+        _out[0].append(data, len, LogLevel::value::UNKNOW);
+        _out[0].write();
+    }
+
+    MYLOG_INLINE void FileSink::log(const char *data, size_t len) {
+        logBatch(data, len, LogBatch());
+    }
+
+    MYLOG_INLINE void RollBySizeSink::log(const char *data, size_t len) {
+        logBatch(data, len, LogBatch());
+    }
 
+    MYLOG_INLINE void SharedFileSink::log(const char *data, size_t len) {
+        SharedFile::write(_fd, data, len);
+    }
+
+    MYLOG_INLINE void SharedRollBySizeSink::log(const char *data, size_t len) {
+        struct stat st;
+        if (fstat(_fd, &st) == 0 && (size_t)st.st_size >= _max_fsize) rotate(st);
+        SharedFile::write(_fd, data, len);
+    }
+
+    MYLOG_INLINE void NetworkSink::log(const char *data, size_t len) {
+        // 1. 按协议组织报文，追加到积压队列
+        enqueue(data, len);
+        // 2. 在时间预算内尽量发送
+        flushBacklog(_budget_ms);
+    }
+
+    MYLOG_INLINE void ShmSink::log(const char *data, size_t len) {
+        _ring.push(data, len);
+    }
+#endif
+}
 
 #endif /* __M_SINK_H__ */
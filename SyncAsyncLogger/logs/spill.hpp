@@ -0,0 +1,111 @@
+#ifndef __M_SPILL_H__
+#define __M_SPILL_H__
+/*
+    异步缓冲区的溢出文件：落地模块跟不上时，生产缓冲区中超过阈值的数据整批追加到本地文件，落地恢复后按顺序重放
+    1. 文件创建后立即删除（O_TMPFILE 或 mkstemp + unlink），进程退出后不会留下残余文件
+    2. 只顺序追加写入；每批数据的位置、长度、截至该批的日志数量与概要信息保存在内存中
+    3. 待重放的数据全部重放后截断为空文件，积压消失后磁盘空间随之释放
+*/
+
+#include <deque>
+#include <string>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include "util.hpp"
+#include "index.hpp"
+
+namespace mylog {
+    class SpillFile {
+    public:
+        // 溢出的一批数据
+        struct Chunk {
+            uint64_t _offset;
+            size_t _len;
+            uint64_t _seq;   // 截至这批数据（含）写入的日志数量
+            LogBatch _batch;
+        };
+        SpillFile(): _fd(-1), _end(0), _total(0) {}
+        ~SpillFile() { close(); }
+        // 在目录 dir 中创建溢出文件
+        bool open(const std::string &dir) {
+            close();
+            _dir = dir;
+            util::File::createDirectory(dir.empty() || dir.back() == '/' ? dir : dir + "/");
+#ifdef O_TMPFILE
+            _fd = ::open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+            if (_fd < 0) {
+                std::string tmpl = dir + "/mylog-spill-XXXXXX";
+                _fd = mkstemp(&tmpl[0]);
+                if (_fd < 0) return false;
+                unlink(tmpl.c_str());
+                fcntl(_fd, F_SETFD, FD_CLOEXEC);
+            }
+            return true;
+        }
+        void close() {
+            if (_fd >= 0) ::close(_fd);
+            _fd = -1;
+            _end = 0;
+            _chunks.clear();
+        }
+        bool isOpen() const { return _fd >= 0; }
+        // 追加一批数据，写入失败（如磁盘已满）时返回 false，已写入的部分在下次追加时被覆盖
+        bool append(const char *data, size_t len, uint64_t seq, const LogBatch &batch) {
+            size_t done = 0;
+            while (done < len) {
+                ssize_t ret = pwrite(_fd, data + done, len - done, _end + done);
+                if (ret < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+                done += ret;
+            }
+            _chunks.push_back(Chunk{_end, len, seq, batch});
+            _end += len;
+            _total.fetch_add(len, std::memory_order_relaxed);
+            return true;
+        }
+        bool empty() const { return _chunks.empty(); }
+        // 取出最早的一批数据
+        Chunk pop() {
+            Chunk chunk = _chunks.front();
+            _chunks.pop_front();
+            return chunk;
+        }
+        // 读取一批数据；只读取已经写入的区域，不需要与追加互斥
+        bool read(const Chunk &chunk, std::string &out) {
+            out.resize(chunk._len);
+            size_t done = 0;
+            while (done < chunk._len) {
+                ssize_t ret = pread(_fd, &out[done], chunk._len - done, chunk._offset + done);
+                if (ret < 0 && errno == EINTR) continue;
+                if (ret <= 0) return false;
+                done += ret;
+            }
+            return true;
+        }
+        // 没有待重放的数据时截断文件（须在读取完毕之后调用）
+        void truncate() {
+            if (!_chunks.empty() || _end == 0) return;
+            if (ftruncate(_fd, 0) == 0) _end = 0;
+        }
+        // fork 之后的子进程不能写入与父进程共享的文件，待重放的数据属于父进程
+        void afterFork(bool child) {
+            if (child && isOpen()) open(_dir);
+        }
+        // 累计溢出的字节数
+        uint64_t total() const { return _total.load(std::memory_order_relaxed); }
+    private:
+        std::string _dir;
+        int _fd;
+        uint64_t _end;                // 文件中已写入数据的末尾
+        std::deque<Chunk> _chunks;    // 待重放的数据
+        std::atomic<uint64_t> _total;
+    };
+}
+
+#endif /* __M_SPILL_H__ */
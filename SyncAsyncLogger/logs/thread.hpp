@@ -0,0 +1,100 @@
+#ifndef __M_THREAD_H__
+#define __M_THREAD_H__
+/*
+    可以在 fork 之后的子进程中重新启动的后台线程与条件变量
+    子进程中只有调用 fork 的线程，父进程中的其他线程都不存在了：
+    1. std::thread 对象对应父进程的线程，既不能 join、detach，也不能被重新赋值或在原位置重新构造；
+       这里只保存 pthread_t 句柄，子进程中丢弃旧句柄（不再访问）后重新创建线程
+    2. 条件变量可能残留父进程中等待者的状态，std::condition_variable 同样不能在原位置重新构造；
+       这里直接持有 pthread_cond_t，子进程中重新初始化（此时不存在任何等待者，旧状态不会再被访问）
+    互斥锁在 fork 期间由调用 fork 的线程持有，子进程中由同一线程释放，仍使用 std::mutex
+*/
+
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <system_error>
+#include <cerrno>
+#include <ctime>
+#include <pthread.h>
+
+namespace mylog {
+    // 与 std::condition_variable 用法相同（配合 std::unique_lock<std::mutex>），超时等待使用单调时钟
+    class Cond {
+    public:
+        Cond() { init(); }
+        ~Cond() { pthread_cond_destroy(&_cond); }
+        Cond(const Cond &) = delete;
+        Cond &operator=(const Cond &) = delete;
+        void notify_one() { pthread_cond_signal(&_cond); }
+        void notify_all() { pthread_cond_broadcast(&_cond); }
+        void wait(std::unique_lock<std::mutex> &lock) { pthread_cond_wait(&_cond, lock.mutex()->native_handle()); }
+        template<typename Pred>
+        void wait(std::unique_lock<std::mutex> &lock, Pred pred) {
+            while (!pred()) wait(lock);
+        }
+        // 超时后返回 pred() 的结果
+        template<typename Rep, typename Period, typename Pred>
+        bool wait_for(std::unique_lock<std::mutex> &lock, const std::chrono::duration<Rep, Period> &timeout, Pred pred) {
+            int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += ns / 1000000000;
+            ts.tv_nsec += ns % 1000000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ++ts.tv_sec;
+                ts.tv_nsec -= 1000000000;
+            }
+            while (!pred()) {
+                if (pthread_cond_timedwait(&_cond, lock.mutex()->native_handle(), &ts) == ETIMEDOUT) return pred();
+            }
+            return true;
+        }
+        // 子进程中调用：父进程中等待的线程已不存在，丢弃其留下的状态
+        void reinit() { init(); }
+    private:
+        void init() {
+            pthread_condattr_t attr;
+            pthread_condattr_init(&attr);
+            pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+            pthread_cond_init(&_cond, &attr);
+            pthread_condattr_destroy(&attr);
+        }
+    private:
+        pthread_cond_t _cond;
+    };
+
+    // 后台线程：start 启动，join 等待退出；创建失败时与 std::thread 一样抛出 std::system_error
+    class BackgroundThread {
+    public:
+        BackgroundThread(): _running(false) {}
+        ~BackgroundThread() { join(); }
+        BackgroundThread(const BackgroundThread &) = delete;
+        BackgroundThread &operator=(const BackgroundThread &) = delete;
+        void start(const std::function<void()> &entry) {
+            _entry = entry;
+            int err = pthread_create(&_tid, nullptr, &BackgroundThread::run, this);
+            if (err != 0) throw std::system_error(err, std::generic_category(), "pthread_create");
+            _running = true;
+        }
+        void join() {
+            if (!_running) return;
+            pthread_join(_tid, nullptr);
+            _running = false;
+        }
+        bool running() const { return _running; }
+        // 子进程中调用：句柄对应父进程中的线程，丢弃后可以重新 start
+        void reset() { _running = false; }
+    private:
+        static void *run(void *arg) {
+            static_cast<BackgroundThread *>(arg)->_entry();
+            return nullptr;
+        }
+    private:
+        pthread_t _tid;
+        bool _running;
+        std::function<void()> _entry;
+    };
+}
+
+#endif /* __M_THREAD_H__ */
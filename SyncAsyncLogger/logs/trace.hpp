@@ -0,0 +1,380 @@
+#ifndef __M_TRACE_H__
+#define __M_TRACE_H__
+/*
+    热点路径的计时与追踪事件：MYLOG_SCOPE("name") 计时一个作用域，另有开始/结束/瞬时事件，可附带键值对参数
+    1. 事件以定长的二进制头记录（纳秒时间戳、线程ID、名称指针），名称须为字符串字面量等静态字符串，不拷贝
+    2. 每个线程先写入自己的事件缓冲区（只有一个几乎不会竞争的自旋锁），缓冲区写满或最早的事件超过 TRACE_FLUSH_NS
+       之后整批交给异步工作器，单个事件的开销主要是一次读时钟
+    3. 消费线程将二进制事件交给 TraceSink，转换为 Chrome Trace Event（JSON 数组）格式，可直接由
+       chrome://tracing 或 Perfetto 打开
+    4. 未开始记录时每个追踪点只有一次原子读取
+*/
+
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <fstream>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+#include "clock.hpp"
+#include "context.hpp"
+#include "looper.hpp"
+#include "sink.hpp"
+
+namespace mylog {
+
+    #define TRACE_BUFFER_SIZE (64 * 1024)        // 每个线程的事件缓冲区大小
+    #define TRACE_FLUSH_NS (100 * 1000000LL)     // 线程缓冲区中最早的事件超过该时长后交给异步工作器
+
+    // 二进制事件头，之后紧跟 _args_len 字节的参数（编码与 Record::encodeFields 相同）
+    struct TraceEvent {
+        int64_t _ns;          // 事件时间（X 事件为开始时间）
+        int64_t _dur;         // 持续时间（只用于 X 事件）
+        const char *_name;    // 静态字符串，可为空
+        uint32_t _tid;
+        char _phase;          // B 开始 / E 结束 / i 瞬时 / X 完整的作用域
+        uint8_t _arg_count;
+        uint16_t _args_len;
+    };
+
+    // 追踪事件的落地模块：将二进制事件转换为 Chrome Trace Event JSON 写入文件
+    // 时间戳为相对于创建时刻的微秒数（保留纳秒精度），创建时刻的墙上时间记录在第一个事件 trace_start 的参数中
+    // 析构时写入结尾的 ]（该格式允许省略，进程异常退出时文件仍然可以打开）
+    class TraceSink : public LogSink {
+    public:
+        using ptr = std::shared_ptr<TraceSink>;
+        TraceSink(const std::string &pathname): _pathname(pathname), _base_ns(Clock::now()), _pid(getpid()), _closed(false) {
+            util::File::createDirectory(util::File::path(pathname));
+            _ofs.open(_pathname, std::ios::binary | std::ios::trunc);
+            assert(_ofs.is_open());
+            _ofs << "[\n{\"name\":\"trace_start\",\"ph\":\"i\",\"s\":\"g\",\"ts\":0,\"pid\":" << _pid
+                << ",\"tid\":" << ThreadContext::local().tid()
+                << ",\"args\":{\"unix_ns\":" << _base_ns << ",\"clock\":\"" << Clock::name() << "\"}}";
+        }
+        ~TraceSink() {
+            if (_closed) return;
+            _ofs << "\n]\n";
+        }
+        // data 为若干连续的二进制事件
+        void log(const char *data, size_t len) override {
+            if (_closed) return;
+            const char *end = data + len;
+            while (data + sizeof(TraceEvent) <= end) {
+                TraceEvent ev;
+                memcpy(&ev, data, sizeof(ev));
+                data += sizeof(ev);
+                write(ev, data);
+                data += ev._args_len;
+            }
+        }
+        void flush() override { _ofs.flush(); }
+        // 子进程不再写入与父进程共享的文件，结尾由父进程写入
+        void afterFork(bool child) override {
+            if (child) _closed = true;
+        }
+    private:
+        void write(const TraceEvent &ev, const char *args) {
+            char tmp[64];
+            _ofs << ",\n{\"name\":";
+            if (ev._name) Escape::json(_ofs, ev._name, strlen(ev._name));
+            else _ofs << "\"\"";
+            _ofs << ",\"ph\":\"" << ev._phase << "\",\"ts\":";
+            _ofs.write(tmp, micros(tmp, ev._ns - _base_ns));
+            if (ev._phase == 'X') {
+                _ofs << ",\"dur\":";
+                _ofs.write(tmp, micros(tmp, ev._dur));
+            } else if (ev._phase == 'i') {
+                _ofs << ",\"s\":\"t\"";
+            }
+            _ofs << ",\"pid\":" << _pid << ",\"tid\":" << ev._tid;
+            if (ev._arg_count > 0) {
+                _ofs << ",\"args\":{";
+                const char *p = args;
+                for (size_t i = 0; i < ev._arg_count; ++i) {
+                    Field field;
+                    p = decodeField(p, field);
+                    if (i > 0) _ofs.put(',');
+                    Escape::json(_ofs, field._key, field._key_len);
+                    _ofs.put(':');
+                    Escape::value(_ofs, field, false);
+                }
+                _ofs.put('}');
+            }
+            _ofs.put('}');
+        }
+        // 纳秒转换为带三位小数的微秒
+        static int micros(char *out, int64_t ns) {
+            const char *sign = ns < 0 ? "-" : "";
+            if (ns < 0) ns = -ns;
+            return snprintf(out, 32, "%s%lld.%03lld", sign, (long long)(ns / 1000), (long long)(ns % 1000));
+        }
+        static const char *decodeField(const char *p, Field &field) {
+            uint32_t klen;
+            field._type = (Field::type)*p++;
+            memcpy(&klen, p, sizeof(klen)); p += sizeof(klen);
+            field._key = p; field._key_len = klen; p += klen;
+            if (field._type == Field::type::STRING) {
+                uint32_t vlen;
+                memcpy(&vlen, p, sizeof(vlen)); p += sizeof(vlen);
+                field._value._str = p; field._len = vlen; p += vlen;
+            } else {
+                memcpy(&field._value, p, sizeof(field._value)); p += sizeof(field._value);
+            }
+            return p;
+        }
+    private:
+        std::string _pathname;
+        std::ofstream _ofs;
+        int64_t _base_ns;
+        pid_t _pid;
+        bool _closed;
+    };
+
+    class Tracer {
+    public:
+        static Tracer &instance() {
+            static Tracer tracer;
+            return tracer;
+        }
+        // 开始记录，事件经异步工作器交给 sink；已在记录时替换落地模块（此前的事件先全部落地）
+        void start(const LogSink::ptr &sink, AsyncType type = AsyncType::ASYNC_SAVE) {
+            std::unique_lock<std::mutex> lock(_control_mutex);
+            if (_enabled.load(std::memory_order_relaxed)) stopLocked();
+            if (!_looper) {
+                _looper = std::make_shared<AsyncLooper>(
+                    std::bind(&Tracer::consume, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                    type, std::bind(&Tracer::flushSink, this));
+            }
+            {
+                std::unique_lock<std::mutex> slock(_sink_mutex);
+                _sink = sink;
+            }
+            _enabled.store(true, std::memory_order_release);
+        }
+        // 停止记录：各线程缓冲区中的事件全部落地后释放落地模块
+        void stop() {
+            std::unique_lock<std::mutex> lock(_control_mutex);
+            stopLocked();
+        }
+        // 各线程缓冲区中已记录的事件全部落地
+        void flush() {
+            std::unique_lock<std::mutex> lock(_control_mutex);
+            if (!_looper) return;
+            drain();
+            LogAwaitable(_looper).wait();
+        }
+        bool enabled() const { return _enabled.load(std::memory_order_acquire); }
+
+        // 开始事件，与同一线程上的结束事件配对
+        void begin(const char *name) { record('B', name, Clock::now(), 0, nullptr, 0); }
+        template<typename ...Fields>
+        void begin(const char *name, const Field &field, const Fields &...fields) {
+            const Field arr[] = { field, fields... };
+            record('B', name, Clock::now(), 0, arr, sizeof...(fields) + 1);
+        }
+        void end(const char *name = nullptr) { record('E', name, Clock::now(), 0, nullptr, 0); }
+        template<typename ...Fields>
+        void end(const char *name, const Field &field, const Fields &...fields) {
+            const Field arr[] = { field, fields... };
+            record('E', name, Clock::now(), 0, arr, sizeof...(fields) + 1);
+        }
+        // 瞬时事件
+        void instant(const char *name) { record('i', name, Clock::now(), 0, nullptr, 0); }
+        template<typename ...Fields>
+        void instant(const char *name, const Field &field, const Fields &...fields) {
+            const Field arr[] = { field, fields... };
+            record('i', name, Clock::now(), 0, arr, sizeof...(fields) + 1);
+        }
+        // 已完成的作用域：开始时间与持续时间（纳秒）
+        void complete(const char *name, int64_t start_ns, int64_t dur_ns) { record('X', name, start_ns, dur_ns, nullptr, 0); }
+
+        // 事件的编码与写入：未开始记录时直接返回；参数超过缓冲区大小的事件被丢弃
+        void record(char phase, const char *name, int64_t ns, int64_t dur, const Field *fields, size_t count) {
+            // 与 start 中的 release 配对：看到开启标志时，工作器与落地模块已经就绪
+            if (_enabled.load(std::memory_order_acquire) == false) return;
+            size_t args = 0;
+            for (size_t i = 0; i < count; ++i)
+                args += 1 + sizeof(uint32_t) + fields[i]._key_len +
+                    (fields[i]._type == Field::type::STRING ? sizeof(uint32_t) + fields[i]._len : sizeof(Field::Value));
+            size_t len = sizeof(TraceEvent) + args;
+            if (len > TRACE_BUFFER_SIZE || args > UINT16_MAX || count > UINT8_MAX) return;
+            Buffer *buf = local();
+            SpinGuard guard(buf->_lock);
+            int64_t now = ns + dur;
+            if (buf->_len + len > TRACE_BUFFER_SIZE || (buf->_len > 0 && now - buf->_first_ns > TRACE_FLUSH_NS)) push(buf);
+            if (buf->_len == 0) buf->_first_ns = now;
+            TraceEvent ev;
+            ev._ns = ns;
+            ev._dur = dur;
+            ev._name = name;
+            ev._tid = ThreadContext::local().tid();
+            ev._phase = phase;
+            ev._arg_count = count;
+            ev._args_len = args;
+            char *p = buf->_data + buf->_len;
+            memcpy(p, &ev, sizeof(ev));
+            p += sizeof(ev);
+            for (size_t i = 0; i < count; ++i) p = encodeField(p, fields[i]);
+            buf->_len += len;
+        }
+    private:
+        // 线程的事件缓冲区：只有所属线程写入，drain 与 fork 时由其他线程加锁取走
+        struct Buffer {
+            std::atomic_flag _lock;
+            size_t _len;
+            int64_t _first_ns;
+            char _data[TRACE_BUFFER_SIZE];
+            Buffer(): _len(0), _first_ns(0) { _lock.clear(); }
+        };
+        class SpinGuard {
+        public:
+            SpinGuard(std::atomic_flag &flag): _flag(flag) {
+                while (_flag.test_and_set(std::memory_order_acquire)) sched_yield();
+            }
+            ~SpinGuard() { _flag.clear(std::memory_order_release); }
+        private:
+            std::atomic_flag &_flag;
+        };
+        // 线程退出时交出剩余的事件并注销缓冲区
+        struct Holder {
+            Buffer *_buf;
+            Holder(): _buf(nullptr) {}
+            ~Holder() { if (_buf) Tracer::instance().release(_buf); }
+        };
+
+        Tracer(): _enabled(false) {
+            pthread_atfork(&Tracer::prepareFork, &Tracer::parentAfterFork, &Tracer::childAfterFork);
+        }
+        ~Tracer() { stop(); }
+        Buffer *local() {
+            static thread_local Holder holder;
+            if (holder._buf == nullptr) {
+                holder._buf = new Buffer();
+                std::unique_lock<std::mutex> lock(_mutex);
+                _buffers.push_back(holder._buf);
+            }
+            return holder._buf;
+        }
+        void release(Buffer *buf) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            {
+                SpinGuard guard(buf->_lock);
+                push(buf);
+            }
+            _buffers.erase(std::find(_buffers.begin(), _buffers.end(), buf));
+            delete buf;
+        }
+        // 持有 buf 的锁时调用：将缓冲区中的事件交给异步工作器
+        void push(Buffer *buf) {
+            if (buf->_len > 0 && _looper) _looper->push(buf->_data, buf->_len);
+            buf->_len = 0;
+        }
+        void drain() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (Buffer *buf : _buffers) {
+                SpinGuard guard(buf->_lock);
+                push(buf);
+            }
+        }
+        // 先停止记录再取走各线程的事件；停止之后仍在写入的线程留下的事件在下次取走时因没有落地模块而丢弃
+        // 异步工作器不随之销毁，此时可能仍有线程正在写入
+        void stopLocked() {
+            if (!_looper) return;
+            _enabled.store(false, std::memory_order_release);
+            drain();
+            LogAwaitable(_looper).wait();
+            std::unique_lock<std::mutex> slock(_sink_mutex);
+            _sink.reset();
+        }
+        void consume(const char *data, size_t len, const LogBatch &) {
+            std::unique_lock<std::mutex> lock(_sink_mutex);
+            if (_sink) _sink->log(data, len);
+        }
+        void flushSink() {
+            std::unique_lock<std::mutex> lock(_sink_mutex);
+            if (_sink) _sink->flush();
+        }
+        static char *encodeField(char *p, const Field &field) {
+            uint32_t klen = field._key_len;
+            *p++ = (char)field._type;
+            memcpy(p, &klen, sizeof(klen)); p += sizeof(klen);
+            memcpy(p, field._key, klen); p += klen;
+            if (field._type == Field::type::STRING) {
+                uint32_t vlen = field._len;
+                memcpy(p, &vlen, sizeof(vlen)); p += sizeof(vlen);
+                memcpy(p, field._value._str, vlen); p += vlen;
+            } else {
+                memcpy(p, &field._value, sizeof(field._value)); p += sizeof(field._value);
+            }
+            return p;
+        }
+        // fork 之前按 start / stop 的加锁顺序获取控制锁、缓冲区列表与各缓冲区的锁，等待异步工作器空闲后
+        // 获取落地模块的锁并刷新；这些锁在父子进程中都由调用 fork 的线程释放
+        // 子进程中：其他线程的缓冲区与尚未落地的事件属于父进程，清空后停止记录，追踪文件留给父进程
+        static void prepareFork() {
+            Tracer &tracer = instance();
+            tracer._control_mutex.lock();
+            tracer._mutex.lock();
+            for (Buffer *buf : tracer._buffers) while (buf->_lock.test_and_set(std::memory_order_acquire)) sched_yield();
+            if (tracer._looper) tracer._looper->prepareFork();
+            tracer._sink_mutex.lock();
+            if (tracer._sink) tracer._sink->flush();
+        }
+        static void parentAfterFork() { instance().afterFork(false); }
+        static void childAfterFork() {
+            ThreadContext::local().refreshTid();
+            instance().afterFork(true);
+        }
+        void afterFork(bool child) {
+            if (_looper) _looper->afterFork(child);
+            if (child) {
+                _enabled.store(false, std::memory_order_relaxed);
+                for (Buffer *buf : _buffers) buf->_len = 0;
+                if (_sink) _sink->afterFork(child);
+            }
+            _sink_mutex.unlock();
+            for (Buffer *buf : _buffers) buf->_lock.clear(std::memory_order_release);
+            _mutex.unlock();
+            _control_mutex.unlock();
+        }
+    private:
+        std::atomic<bool> _enabled;
+        std::mutex _control_mutex;        // 串行化 start / stop / flush
+        std::mutex _mutex;                // 保护线程缓冲区列表
+        std::vector<Buffer *> _buffers;
+        AsyncLooper::ptr _looper;
+        std::mutex _sink_mutex;
+        LogSink::ptr _sink;
+    };
+
+    // 作用域计时：构造时记录开始时间，析构时写入一个 X 事件；构造时未在记录则不计时
+    class TraceScope {
+    public:
+        explicit TraceScope(const char *name): _tracer(Tracer::instance()), _name(name), _start(0) {
+            if (_tracer.enabled()) _start = Clock::now();
+        }
+        ~TraceScope() {
+            if (_start != 0) _tracer.complete(_name, _start, Clock::now() - _start);
+        }
+        TraceScope(const TraceScope &) = delete;
+        TraceScope &operator=(const TraceScope &) = delete;
+    private:
+        Tracer &_tracer;
+        const char *_name;
+        int64_t _start;
+    };
+
+    // 追踪点（名称须为字符串字面量），由 Tracer::instance().start(sink) 开始记录
+    #define MYLOG_CONCAT_IMPL(a, b) a##b
+    #define MYLOG_CONCAT(a, b) MYLOG_CONCAT_IMPL(a, b)
+    #define MYLOG_SCOPE(name) mylog::TraceScope MYLOG_CONCAT(_mylog_scope_, __LINE__)(name)
+    #define MYLOG_TRACE_BEGIN(name, ...) mylog::Tracer::instance().begin(name, ##__VA_ARGS__)
+    #define MYLOG_TRACE_END(name, ...) mylog::Tracer::instance().end(name, ##__VA_ARGS__)
+    #define MYLOG_TRACE_INSTANT(name, ...) mylog::Tracer::instance().instant(name, ##__VA_ARGS__)
+}
+
+#endif /* __M_TRACE_H__ */
@@ -9,10 +9,21 @@
 */ 
 
 #include <iostream>
+#include <string>
 #include <ctime>
-// #include <unistd.h>
+#include <cstdio>
+#include <cstdarg>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
+// 类外定义的非模板成员：头文件单独使用时为内联函数，链接 libmylog（定义 MYLOG_USE_LIBRARY）时由 mylog.cc 提供唯一的定义
+#ifdef MYLOG_USE_LIBRARY
+#define MYLOG_INLINE
+#else
+#define MYLOG_INLINE inline
+#endif
+
 namespace mylog {
     namespace util {
         class Date {
@@ -31,6 +42,20 @@ namespace mylog {
                 return true;
                 // return (access(pathname.c_str(), F_OK) == 0);
             }
+            static size_t size(const std::string &pathname) {
+                struct stat st;
+                if (stat(pathname.c_str(), &st) < 0) {
+                    return 0;
+                }
+                return st.st_size;
+            }
+            // 将文件已交给操作系统的数据持久化到存储设备（任意打开的描述符都可以 fsync 同一文件）
+            static void sync(const std::string &pathname) {
+                int fd = ::open(pathname.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0) return;
+                ::fsync(fd);
+                ::close(fd);
+            }
             static std::string path(const std::string &pathname) {
                 // ./a/b/c/a.txt
                 // 查找最后一个 /
@@ -45,8 +70,10 @@ namespace mylog {
                     pos = pathname.find_first_of("/\\", idx);
                     if (pos == std::string::npos) {
                         mkdir(pathname.c_str(), 0777);
+                        break;
                     }
-                    std::string parent_dir = pathname.substr(idx, pos + 1);
+                    // 逐级创建：取从开头到当前分隔符的前缀
+                    std::string parent_dir = pathname.substr(0, pos + 1);
                     // if (parent_dir == "." || parent_dir == "..") { idx = pos + 1; continue; }
                     if (exists(parent_dir) == true) { idx = pos + 1; continue; }
                     mkdir(parent_dir.c_str(), 0777);
@@ -55,6 +82,25 @@ namespace mylog {
                 }
             }
         };
+        class Str {
+        public:
+            // 将格式化结果写入 out 已有的空间中，空间不够时扩容后重新格式化，out 复用时不会产生内存分配
+            static bool vformat(std::string &out, const char *fmt, va_list ap) {
+                if (out.capacity() < 128) out.reserve(128);
+                out.resize(out.capacity());
+                va_list cp;
+                va_copy(cp, ap);
+                int ret = vsnprintf(&out[0], out.size() + 1, fmt, cp);
+                va_end(cp);
+                if (ret < 0) { out.clear(); return false; }
+                if ((size_t)ret > out.size()) {
+                    out.resize(ret);
+                    vsnprintf(&out[0], out.size() + 1, fmt, ap);
+                }
+                out.resize(ret);
+                return true;
+            }
+        };
         class Thread {
         public:
             static uint64_t tid() {
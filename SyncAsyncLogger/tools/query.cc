@@ -0,0 +1,454 @@
+/*
+    日志查询工具：借助日志文件的旁路索引（<文件名>.idx），只扫描符合条件的数据块
+    用法：mylog-query [-s 开始时间] [-e 结束时间] [-l 最低等级] [-c 日志器] [-g 文本] [-p 输出格式] [-j 线程数] 日志文件...
+    1. 时间格式为 "2025-07-10 12:30:00" 或秒级时间戳
+    2. 时间、等级与日志器先按数据块过滤；数据块不完全落在条件之内时，再按 -p 指定的输出格式（默认为日志器的默认格式）
+       解析每行开头的时间（%d）、等级（%p）与日志器（%c）逐行过滤，无法解析的行（如多行日志的后续行）跟随上一行
+    3. 格式中的时间不含日期时，日期取自数据块的起始时间（没有索引时取自文件的修改时间）
+    4. -g 进一步按行过滤包含指定文本的日志
+    5. 没有索引的文件、索引之后尚未记录的尾部（如进程异常退出）总是完整扫描
+    6. 多个文件由多个线程并行扫描，结果按块交给主线程，按命令行中的文件顺序边扫描边输出；
+       尚未轮到输出的文件最多缓存 QUERY_MAX_AHEAD 字节的结果，内存占用与文件大小无关
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../logs/index.hpp"
+
+#define QUERY_CHUNK_SIZE (1024 * 1024)    // 扫描结果按块交给输出线程
+#define QUERY_MAX_AHEAD (8 * 1024 * 1024) // 尚未轮到输出的文件最多缓存的结果字节数
+#define QUERY_MAX_HEAD 512                // 解析每行开头时最多查看的字节数
+#define DEFAULT_PATTERN "[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n" // 与 Formatter 的默认格式一致
+
+struct Query {
+    int64_t _start = 0;
+    int64_t _end = INT64_MAX;
+    uint32_t _levels = UINT32_MAX;
+    bool _has_logger = false;
+    uint32_t _logger = 0;
+    std::string _logger_name;
+    std::string _grep;
+};
+
+struct Range {
+    uint64_t _offset;
+    uint64_t _len;
+    bool _check;  // 需要逐行检查时间、等级与日志器
+    int64_t _ref; // 格式中的时间不含日期时的参考时间（秒）
+};
+
+// 只读映射整个文件
+class MappedFile {
+public:
+    MappedFile(const std::string &pathname): _data(nullptr), _size(0), _mtime(0) {
+        int fd = open(pathname.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                _data = (const char *)addr;
+                _size = st.st_size;
+                _mtime = st.st_mtime;
+            }
+        }
+        close(fd);
+    }
+    ~MappedFile() { if (_data) munmap((void *)_data, _size); }
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+    time_t mtime() const { return _mtime; }
+private:
+    const char *_data;
+    size_t _size;
+    time_t _mtime;
+};
+
+// 按日志输出格式解析每行开头的时间、等级与日志器名称
+class LineParser {
+public:
+    struct Fields {
+        bool _has_time = false;
+        bool _has_level = false;
+        bool _has_logger = false;
+        int64_t _time = 0;
+        int _level = 0;
+        std::string _logger;
+    };
+    LineParser(const std::string &pattern): _has_day(false) { compile(pattern); }
+    // 解析成功返回 true（格式中不含的字段在 Fields 中标记为不存在）；ref 为时间不含日期时的参考时间
+    bool parse(const char *line, size_t len, int64_t ref, Fields &f) const {
+        char buf[QUERY_MAX_HEAD + 1];
+        len = std::min<size_t>(len, QUERY_MAX_HEAD);
+        memcpy(buf, line, len);
+        buf[len] = '\0';
+        const char *p = buf;
+        for (size_t i = 0; i < _tokens.size(); ++i) {
+            const Token &tok = _tokens[i];
+            switch (tok._type) {
+                case Token::LITERAL:
+                    if (strncmp(p, tok._text.c_str(), tok._text.size()) != 0) return false;
+                    p += tok._text.size();
+                    break;
+                case Token::TIME:
+                    if ((p = parseTime(tok, p, ref, f._time)) == nullptr) return false;
+                    f._has_time = true;
+                    break;
+                case Token::LEVEL:
+                    if ((p = parseLevel(p, f._level)) == nullptr) return false;
+                    f._has_level = true;
+                    break;
+                case Token::LOGGER:
+                case Token::SKIP: {
+                    // 字段内容到下一段原样文本为止，后面没有原样文本时无法确定边界，停止解析
+                    if (i + 1 == _tokens.size() || _tokens[i + 1]._type != Token::LITERAL) return true;
+                    const char *next = strstr(p, _tokens[i + 1]._text.c_str());
+                    if (next == nullptr) return false;
+                    if (tok._type == Token::LOGGER) {
+                        f._logger.assign(p, next - p);
+                        f._has_logger = true;
+                    }
+                    p = next;
+                    break;
+                }
+                case Token::STOP:
+                    return true;
+            }
+        }
+        return true;
+    }
+private:
+    struct Token {
+        enum type { LITERAL, TIME, LEVEL, LOGGER, SKIP, STOP } _type;
+        std::string _text; // 原样文本，或时间的 strftime 格式
+    };
+    void push(Token::type type, const std::string &text = "") {
+        if (type == Token::LITERAL && !_tokens.empty() && _tokens.back()._type == Token::LITERAL) {
+            _tokens.back()._text += text;
+            return;
+        }
+        _tokens.push_back(Token{type, text});
+    }
+    // 与 Formatter::parsePattern 相同的格式规则；消息及其后的内容不参与解析
+    void compile(const std::string &pattern) {
+        size_t pos = 0;
+        while (pos < pattern.size()) {
+            if (pattern[pos] != '%' || pos + 1 == pattern.size()) {
+                push(Token::LITERAL, std::string(1, pattern[pos++]));
+                continue;
+            }
+            char key = pattern[pos + 1];
+            pos += 2;
+            std::string sub;
+            if (pos < pattern.size() && pattern[pos] == '{') {
+                size_t close = pattern.find('}', pos);
+                if (close == std::string::npos) close = pattern.size();
+                sub = pattern.substr(pos + 1, close - pos - 1);
+                pos = close + 1;
+            }
+            switch (key) {
+                case '%': push(Token::LITERAL, "%"); break;
+                case 'T': push(Token::LITERAL, "\t"); break;
+                case 'd':
+                    if (sub.empty()) sub = "%H:%M:%S";
+                    push(Token::TIME, sub);
+                    for (const char *d : {"%d", "%e", "%F", "%D", "%j", "%s"}) {
+                        if (sub.find(d) != std::string::npos) _has_day = true;
+                    }
+                    break;
+                case 'p': push(Token::LEVEL); break;
+                case 'c': push(Token::LOGGER); break;
+                case 'm': case 'n': case 'K': case 'J': case 'L': push(Token::STOP); return;
+                default: push(Token::SKIP); break;
+            }
+        }
+    }
+    // 按 strftime 格式解析时间，%N / %3N / %6N / %9N 表示的小数部分直接跳过
+    const char *parseTime(const Token &tok, const char *p, int64_t ref, int64_t &out) const {
+        struct tm tm;
+        time_t base = ref;
+        localtime_r(&base, &tm);
+        const std::string &fmt = tok._text;
+        size_t start = 0;
+        while (start <= fmt.size()) {
+            size_t frac = start;
+            size_t skip = 0;
+            for (; frac < fmt.size(); ++frac) {
+                if (fmt[frac] != '%' || frac + 1 >= fmt.size()) continue;
+                size_t j = frac + 1;
+                if (fmt[j] >= '1' && fmt[j] <= '9') ++j;
+                if (j < fmt.size() && fmt[j] == 'N') { skip = j + 1 - frac; break; }
+                ++frac; // 跳过其他转换说明符
+            }
+            std::string seg = fmt.substr(start, frac - start);
+            if (seg.empty() == false && (p = strptime(p, seg.c_str(), &tm)) == nullptr) return nullptr;
+            if (skip == 0) break;
+            while (*p >= '0' && *p <= '9') ++p;
+            start = frac + skip;
+        }
+        tm.tm_isdst = -1;
+        out = mktime(&tm);
+        // 不含日期时，早于参考时间的时刻属于跨过午夜之后的下一天
+        if (_has_day == false && out < ref) out += 24 * 3600;
+        return p;
+    }
+    static const char *parseLevel(const char *p, int &level) {
+        for (int l = (int)mylog::LogLevel::value::DEBUG; l < (int)mylog::LogLevel::value::OFF; ++l) {
+            const char *name = mylog::LogLevel::toString((mylog::LogLevel::value)l);
+            size_t n = strlen(name);
+            if (strncmp(p, name, n) == 0) {
+                level = l;
+                return p + n;
+            }
+        }
+        return nullptr;
+    }
+private:
+    std::vector<Token> _tokens;
+    bool _has_day; // 时间格式中包含日期
+};
+
+static bool keep(const LineParser::Fields &f, const Query &q) {
+    if (f._has_time && (f._time < q._start || f._time > q._end)) return false;
+    if (f._has_level && (q._levels & (1u << f._level)) == 0) return false;
+    if (f._has_logger && q._has_logger && f._logger != q._logger_name) return false;
+    return true;
+}
+
+static bool match(const mylog::IndexEntry &entry, const Query &q) {
+    if (entry._levels == 0) return true; // 没有概要信息的数据块（未经日志器写入）无法判断，总是扫描
+    if (entry._max_time < q._start || entry._min_time > q._end) return false;
+    if ((entry._levels & q._levels) == 0) return false;
+    if (q._has_logger && entry._logger != q._logger) return false;
+    return true;
+}
+
+// 数据块中的日志全部符合条件，无需逐行检查（日志器变化时数据块即结束，match 已经保证日志器相同）
+static bool inside(const mylog::IndexEntry &entry, const Query &q) {
+    if (entry._levels == 0) return false;
+    if (entry._min_time < q._start || entry._max_time > q._end) return false;
+    return (entry._levels & ~q._levels) == 0;
+}
+
+// 没有索引时以文件修改时间所在日期的零点作为参考时间
+static int64_t midnight(time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+// 根据索引选出需要扫描的区间，相邻且检查方式相同的区间合并
+static std::vector<Range> select(const std::string &pathname, size_t fsize, time_t mtime, const Query &q) {
+    std::vector<Range> ranges;
+    auto add = [&](uint64_t offset, uint64_t len, bool check, int64_t ref) {
+        if (offset >= fsize || len == 0) return;
+        if (offset + len > fsize) len = fsize - offset;
+        if (!ranges.empty() && ranges.back()._offset + ranges.back()._len == offset && ranges.back()._check == check) {
+            ranges.back()._len += len;
+        } else {
+            ranges.push_back(Range{offset, len, check, ref});
+        }
+    };
+    MappedFile idx(pathname + INDEX_SUFFIX);
+    const mylog::IndexHeader *hdr = (const mylog::IndexHeader *)idx.data();
+    if (hdr == nullptr || idx.size() < sizeof(*hdr) || hdr->_magic != INDEX_MAGIC || hdr->_version != INDEX_VERSION) {
+        add(0, fsize, true, midnight(mtime));
+        return ranges;
+    }
+    size_t count = (idx.size() - sizeof(*hdr)) / sizeof(mylog::IndexEntry);
+    const mylog::IndexEntry *entries = (const mylog::IndexEntry *)(idx.data() + sizeof(*hdr));
+    uint64_t indexed = 0;
+    int64_t last_time = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (match(entries[i], q)) add(entries[i]._offset, entries[i]._len, !inside(entries[i], q), entries[i]._min_time);
+        indexed = std::max<uint64_t>(indexed, entries[i]._offset + entries[i]._len);
+        if (entries[i]._levels != 0) last_time = std::max<int64_t>(last_time, entries[i]._max_time);
+    }
+    if (indexed < fsize) add(indexed, fsize - indexed, true, last_time > 0 ? last_time : midnight(mtime));
+    return ranges;
+}
+
+// 每个文件的扫描结果：扫描线程按块追加，主线程按文件顺序取出输出
+struct Result {
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::string> _chunks;
+    size_t _bytes = 0;
+    bool _done = false;
+};
+
+class Printer {
+public:
+    Printer(size_t files): _cursor(0) {
+        for (size_t i = 0; i < files; ++i) _results.emplace_back(new Result());
+    }
+    // 扫描线程：尚未轮到输出的文件缓存的结果超过上限时等待
+    void push(size_t idx, std::string &chunk) {
+        if (chunk.empty()) return;
+        Result &res = *_results[idx];
+        std::unique_lock<std::mutex> lock(res._mutex);
+        res._cond.wait(lock, [&](){ return _cursor == idx || res._bytes < QUERY_MAX_AHEAD; });
+        res._bytes += chunk.size();
+        res._chunks.push_back(std::string());
+        res._chunks.back().swap(chunk);
+        res._cond.notify_all();
+    }
+    void finish(size_t idx) {
+        Result &res = *_results[idx];
+        std::unique_lock<std::mutex> lock(res._mutex);
+        res._done = true;
+        res._cond.notify_all();
+    }
+    // 主线程：按文件顺序输出，轮到的文件不再受缓存上限的限制
+    void run() {
+        for (size_t i = 0; i < _results.size(); ++i) {
+            Result &res = *_results[i];
+            std::unique_lock<std::mutex> lock(res._mutex);
+            _cursor = i;
+            res._cond.notify_all();
+            while (1) {
+                res._cond.wait(lock, [&](){ return !res._chunks.empty() || res._done; });
+                if (res._chunks.empty()) break;
+                std::string chunk;
+                chunk.swap(res._chunks.front());
+                res._chunks.pop_front();
+                res._bytes -= chunk.size();
+                lock.unlock();
+                std::cout.write(chunk.data(), chunk.size());
+                lock.lock();
+            }
+            _results[i].reset();
+        }
+        std::cout.flush();
+    }
+private:
+    std::vector<std::unique_ptr<Result>> _results;
+    std::atomic<size_t> _cursor; // 正在输出的文件
+};
+
+static void scan(size_t file_idx, const std::string &pathname, const Query &q, const LineParser &parser, Printer &printer) {
+    MappedFile file(pathname);
+    if (file.data() == nullptr) return;
+    std::vector<Range> ranges = select(pathname, file.size(), file.mtime(), q);
+    std::string out;
+    auto emit = [&](const char *p, size_t len) {
+        out.append(p, len);
+        if (out.size() >= QUERY_CHUNK_SIZE) printer.push(file_idx, out);
+    };
+    LineParser::Fields f;
+    for (auto &range : ranges) {
+        const char *p = file.data() + range._offset;
+        const char *end = p + range._len;
+        if (q._grep.empty() && range._check == false) {
+            for (; p < end; p += QUERY_CHUNK_SIZE) emit(p, std::min<size_t>(end - p, QUERY_CHUNK_SIZE));
+            continue;
+        }
+        bool pass = true; // 无法解析的行沿用上一行的结果
+        while (p < end) {
+            const char *eol = (const char *)memchr(p, '\n', end - p);
+            const char *next = eol ? eol + 1 : end;
+            if (range._check) {
+                f = LineParser::Fields();
+                if (parser.parse(p, next - p, range._ref, f)) pass = keep(f, q);
+            }
+            if (pass && (q._grep.empty() || memmem(p, next - p, q._grep.data(), q._grep.size()) != nullptr)) emit(p, next - p);
+            p = next;
+        }
+    }
+    printer.push(file_idx, out);
+}
+
+static int64_t parseTime(const char *str) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(str, "%Y-%m-%d %H:%M:%S", &tm);
+    if (end == nullptr) end = strptime(str, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (end != nullptr && *end == '\0') {
+        tm.tm_isdst = -1;
+        return mktime(&tm);
+    }
+    return strtoll(str, nullptr, 10);
+}
+
+static bool parseLevel(const char *str, uint32_t *levels) {
+    for (int l = (int)mylog::LogLevel::value::DEBUG; l < (int)mylog::LogLevel::value::OFF; ++l) {
+        if (strcasecmp(str, mylog::LogLevel::toString((mylog::LogLevel::value)l)) == 0) {
+            *levels = ~((1u << l) - 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    Query q;
+    std::string pattern = DEFAULT_PATTERN;
+    size_t threads = std::thread::hardware_concurrency();
+    int opt;
+    while ((opt = getopt(argc, argv, "s:e:l:c:g:p:j:")) != -1) {
+        switch (opt) {
+            case 's': q._start = parseTime(optarg); break;
+            case 'e': q._end = parseTime(optarg); break;
+            case 'l':
+                if (parseLevel(optarg, &q._levels) == false) {
+                    std::cerr << "unknown level: " << optarg << "\n";
+                    return 1;
+                }
+                break;
+            case 'c':
+                q._has_logger = true;
+                q._logger = mylog::IndexWriter::hash(optarg, strlen(optarg));
+                q._logger_name = optarg;
+                break;
+            case 'g': q._grep = optarg; break;
+            case 'p': pattern = optarg; break;
+            case 'j': threads = strtoul(optarg, nullptr, 10); break;
+            default:
+                std::cerr << "usage: " << argv[0]
+                    << " [-s start] [-e end] [-l level] [-c logger] [-g text] [-p pattern] [-j threads] file...\n";
+                return 1;
+        }
+    }
+    std::vector<std::string> files;
+    for (int i = optind; i < argc; ++i) {
+        std::string name = argv[i];
+        size_t slen = strlen(INDEX_SUFFIX);
+        if (name.size() > slen && name.compare(name.size() - slen, slen, INDEX_SUFFIX) == 0) continue;
+        files.push_back(name);
+    }
+    // 各线程依次领取文件进行扫描，主线程按文件顺序输出结果
+    LineParser parser(pattern);
+    Printer printer(files.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < files.size()) {
+            scan(i, files[i], q, parser, printer);
+            printer.finish(i);
+        }
+    };
+    if (threads == 0) threads = 1;
+    if (threads > files.size()) threads = files.size();
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < threads; ++i) pool.emplace_back(worker);
+    printer.run();
+    for (auto &thr : pool) thr.join();
+    return 0;
+}